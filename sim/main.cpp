@@ -0,0 +1,67 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "simulation.h"
+
+namespace {
+    using namespace std::chrono_literals;
+
+    double milliseconds(std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    /**
+     * One row per policy: work done, virtual CPU time per stage as a share of the run, then what clients saw
+     */
+    void report(const sim::scenario& scenario, const sim::policy& policy, const sim::results& results) {
+        const auto share = [&](std::chrono::nanoseconds busy) {
+            return 100.0 * busy.count() / static_cast<double>(scenario.duration.count());
+        };
+        std::printf("%-12s %9llu %9llu %9llu %8llu | %5.1f%% %5.1f%% %5.1f%% | %6llu %6llu | %9llu %6llu %6llu %6llu %6llu | %6lld %6lld %6lld | %8.1f\n",
+                    policy.name,
+                    static_cast<unsigned long long>(results.requests), static_cast<unsigned long long>(results.coalesced),
+                    static_cast<unsigned long long>(results.encodes), static_cast<unsigned long long>(results.send_calls),
+                    share(results.decode_time), share(results.sampling_time), share(results.transmit_time),
+                    static_cast<unsigned long long>(results.overruns), static_cast<unsigned long long>(results.skipped),
+                    static_cast<unsigned long long>(results.delivered), static_cast<unsigned long long>(results.dropped_stale),
+                    static_cast<unsigned long long>(results.dropped_control), static_cast<unsigned long long>(results.refused),
+                    static_cast<unsigned long long>(results.missed),
+                    static_cast<long long>(results.latency.percentile(0.5).count()), static_cast<long long>(results.latency.percentile(0.99).count()),
+                    static_cast<long long>(results.latency.worst.count()), milliseconds(results.wall_time));
+    }
+
+    void compare(const sim::scenario& scenario, std::initializer_list<sim::policy> policies) {
+        std::printf("\n%s: %zu clients over %.0f s simulated\n", scenario.name, scenario.clients, milliseconds(scenario.duration) / 1000);
+        std::printf("%-12s %9s %9s %9s %8s | %6s %6s %6s | %6s %6s | %9s %6s %6s %6s %6s | %6s %6s %6s | %8s\n",
+                    "policy", "requests", "coalesced", "encodes", "sends", "decode", "sample", "send", "overrun", "skip",
+                    "delivered", "stale", "ctrl", "refuse", "missed", "p50us", "p99us", "maxus", "wall ms");
+        for (const auto& policy : policies)
+            report(scenario, policy, sim::run(scenario, policy));
+    }
+}
+
+/**
+ * Plays a few client populations against the publishing policies worth comparing, everything in virtual time
+ * @param argc optionally a seed as the first argument
+ */
+int main(int argc, char** argv) {
+    const auto seed = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1u;
+
+    const sim::policy baseline{.name = "250Hz skip"};
+    const sim::policy catchUp{.name = "250Hz catch", .overrun = utils::overrun_policy::CATCH_UP};
+    const sim::policy uncoalesced{.name = "no coalesce", .coalesce = false};
+    const sim::policy halfRate{.name = "125Hz skip", .sample_period = 8ms};
+    const sim::policy smallBatch{.name = "batch 8", .decode_batch = 8};
+
+    sim::scenario room{.name = "Room", .clients = 400, .repeats = 3, .seed = seed};
+    compare(room, {baseline, catchUp, uncoalesced, halfRate, smallBatch});
+
+    // More subscribers than one sampling period can encode for, until a good part of them leave
+    sim::scenario crowd{.name = "Crowd", .clients = 800, .repeats = 3, .leaving = 0.4, .seed = seed};
+    compare(crowd, {baseline, catchUp, uncoalesced, halfRate, smallBatch});
+
+    // A link too slow for every sample, the send buffer fills and samples go stale in the queues
+    sim::scenario slowLink{.name = "Slow link", .clients = 400, .link_bytes_per_second = 2.5e6, .send_buffer = 65536, .seed = seed};
+    compare(slowLink, {baseline, catchUp, halfRate});
+    return 0;
+}
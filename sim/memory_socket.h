@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <span>
+#include <type_traits>
+
+#include "../src/net/send_queue.hpp"
+#include "virtual_clock.h"
+
+namespace sim {
+    struct datagram {
+        clock::time_point arrival{};
+        sockets::endpoint from{};
+        sockets::endpoint to{};
+        uint16_t length = 0;
+        std::array<uint8_t, net::MAX_DATAGRAM> data{};
+    };
+
+    struct network_stats {
+        uint64_t to_server = 0;
+        uint64_t to_clients = 0;
+        uint64_t bytes_to_clients = 0;
+        // send_batch calls the server made, each one a system call on a real socket
+        uint64_t send_calls = 0;
+        // Datagrams the server's send buffer had no room for
+        uint64_t refused = 0;
+    };
+
+    /**
+     * The wire between the server and its simulated clients: a fixed one way latency, and a link draining the server's
+     * send buffer at a fixed rate. Clients are assumed to always have room.
+     */
+    class memory_network {
+        const virtual_clock& m_clock;
+        clock::duration m_latency;
+        double m_bytes_per_second;
+        double m_buffer_capacity;
+        double m_buffer_used = 0;
+        clock::time_point m_drained{};
+        std::deque<datagram> m_to_server;
+        std::deque<datagram> m_to_clients;
+        network_stats m_stats{};
+    public:
+        /**
+         * @param time the simulation's clock
+         * @param latency the one way delay
+         * @param bytesPerSecond the rate the link takes datagrams out of the send buffer
+         * @param sendBuffer the server's send buffer, in bytes
+         */
+        memory_network(const virtual_clock& time, clock::duration latency, double bytesPerSecond, double sendBuffer)
+        : m_clock(time), m_latency(latency), m_bytes_per_second(bytesPerSecond), m_buffer_capacity(sendBuffer), m_drained(time.now()) {}
+
+        void client_send(const sockets::endpoint& from, const sockets::endpoint& to, std::span<const uint8_t> data) {
+            auto& entry = m_to_server.emplace_back();
+            entry.arrival = m_clock.now() + m_latency;
+            entry.from = from;
+            entry.to = to;
+            entry.length = static_cast<uint16_t>(std::min(data.size(), entry.data.size()));
+            std::memcpy(entry.data.data(), data.data(), entry.length);
+            ++m_stats.to_server;
+        }
+
+        /**
+         * Hands every datagram that has reached its client by now to a callback, in the order they were sent
+         */
+        template <typename Deliver>
+        void deliver(Deliver&& deliver) {
+            while (!m_to_clients.empty() && m_to_clients.front().arrival <= m_clock.now()) {
+                deliver(m_to_clients.front());
+                m_to_clients.pop_front();
+            }
+        }
+
+        /**
+         * @return the oldest datagram that has reached the server by now, nullptr if there isn't one
+         */
+        const datagram* server_peek() const {
+            if (m_to_server.empty() || m_to_server.front().arrival > m_clock.now())
+                return nullptr;
+            return &m_to_server.front();
+        }
+
+        void server_pop() {
+            m_to_server.pop_front();
+        }
+
+        /**
+         * @return false if the send buffer has no room for the datagram
+         */
+        bool server_send(const sockets::endpoint& from, const sockets::endpoint& to, const uint8_t* data, uint16_t length) {
+            const auto now = m_clock.now();
+            m_buffer_used = std::max(0.0, m_buffer_used - std::chrono::duration<double>(now - m_drained).count() * m_bytes_per_second);
+            m_drained = now;
+            if (m_buffer_used + length > m_buffer_capacity) {
+                ++m_stats.refused;
+                return false;
+            }
+            m_buffer_used += length;
+            // Leaves once everything ahead of it in the buffer has gone out
+            const auto queued = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(m_buffer_used / m_bytes_per_second));
+            auto& entry = m_to_clients.emplace_back();
+            entry.arrival = now + queued + m_latency;
+            entry.from = from;
+            entry.to = to;
+            entry.length = length;
+            std::memcpy(entry.data.data(), data, length);
+            ++m_stats.to_clients;
+            m_stats.bytes_to_clients += length;
+            return true;
+        }
+
+        void count_send_call() {
+            ++m_stats.send_calls;
+        }
+
+        [[nodiscard]] const network_stats& stats() const {
+            return m_stats;
+        }
+    };
+
+    /**
+     * Stand-in for sockets::udp_socket on a memory_network, with the same members so the server's code takes either.
+     * Never blocks, waiting doesn't make virtual time pass.
+     */
+    class memory_socket {
+        memory_network& m_network;
+        sockets::endpoint m_local{};
+    public:
+        explicit memory_socket(memory_network& network)
+        : m_network(network) {}
+
+        void bind(const sockets::endpoint& local_ep) {
+            m_local = local_ep;
+        }
+
+        ssize_t receive_from(uint8_t* buffer, uint16_t length, sockets::msg_flags, sockets::endpoint& out_remote_ep) {
+            const auto* const entry = m_network.server_peek();
+            if (entry == nullptr)
+                return -EAGAIN;
+            const auto bytes = std::min(length, entry->length);
+            std::memcpy(buffer, entry->data.data(), bytes);
+            out_remote_ep = entry->from;
+            m_network.server_pop();
+            return bytes;
+        }
+
+        ssize_t send_to(uint8_t* buffer, uint16_t length, sockets::msg_flags, const sockets::endpoint& remote_ep) {
+            m_network.count_send_call();
+            return m_network.server_send(m_local, remote_ep, buffer, length) ? length : -EAGAIN;
+        }
+
+        ssize_t send_batch(std::span<const sockets::outgoing_datagram> datagrams, sockets::msg_flags) {
+            m_network.count_send_call();
+            ssize_t sent = 0;
+            for (const auto& datagram : datagrams) {
+                if (!m_network.server_send(m_local, *datagram.remote_ep, datagram.buffer, datagram.length))
+                    break;
+                ++sent;
+            }
+            return sent == 0 && !datagrams.empty() ? -EAGAIN : sent;
+        }
+
+        bool wait_readable(std::chrono::milliseconds) {
+            return m_network.server_peek() != nullptr;
+        }
+
+        void close() {}
+
+        void shutdown(sockets::shutdown_type) {}
+
+        template <typename Option> requires std::is_void_v<typename Option::value_type>
+        void set_option() {}
+
+        template <typename Option> requires (!std::is_void_v<typename Option::value_type>)
+        void set_option(const typename Option::value_type&) {}
+
+        template <typename Option> requires (!std::is_void_v<typename Option::value_type>)
+        [[nodiscard]] typename Option::value_type get_option() const {
+            return {};
+        }
+
+        void set_capture(sockets::capture_ring*) {}
+    };
+}
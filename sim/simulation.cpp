@@ -0,0 +1,443 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "memory_socket.h"
+#include "../src/dsu/ResponseCache.hpp"
+#include "../src/net/client_registry.hpp"
+#include "../src/net/request_coalescer.hpp"
+
+namespace sim {
+    namespace {
+        // Room for the largest scenario without evictions
+        constexpr size_t CAPACITY = 4096;
+        constexpr uint16_t CLIENT_PORT = 50000;
+        const sockets::endpoint SERVER_EP{0x0A000001, 26760};
+
+        using DSU::Packets::Outgoing::OutgoingPacket;
+
+        /**
+         * Where the packet number and motion timestamp sit in an encoded CONTROLLER_DATA datagram, found by encoding one
+         */
+        struct data_layout {
+            size_t packet_number = 0;
+            size_t timestamp = 0;
+        };
+
+        /**
+         * A datagram the decode or sampling stage handed to transmit, usable once the stage would have finished it
+         */
+        struct staged {
+            clock::time_point ready{};
+            uint16_t client = 0;
+            uint16_t generation = 0;
+            sockets::endpoint remote_ep{};
+            // A cached control reply, or for data the time the sample was taken
+            net::shared_datagram reply{};
+            clock::time_point sample{};
+        };
+
+        struct data_sequence {
+            uint16_t generation = 0;
+            uint32_t packet_number = 0;
+        };
+
+        enum class request_kind : uint8_t {
+            JOIN,
+            DATA,
+            INFO
+        };
+
+        struct client_event {
+            clock::time_point time{};
+            uint32_t client = 0;
+            request_kind kind{};
+
+            bool operator>(const client_event& other) const {
+                return time > other.time;
+            }
+        };
+
+        struct simulated_client {
+            sockets::endpoint ep{};
+            clock::time_point leaves = clock::time_point::max();
+            uint32_t last_packet = 0;
+        };
+
+        /**
+         * The parts of the server a run exercises, the same components the pipeline stages drive
+         */
+        struct server {
+            net::client_registry<CAPACITY> registry;
+            net::request_coalescer<CAPACITY> coalescer;
+            net::send_queues<CAPACITY> queues;
+            DSU::ResponseCache responses;
+            std::array<data_sequence, CAPACITY> sequences{};
+        };
+
+        template <typename T>
+        T read_wire(const uint8_t* data) {
+            T value;
+            std::memcpy(&value, data, sizeof(value));
+            return SwapEndian(value);
+        }
+
+        DSU::Packets::Outgoing::ControllerResponseHead connected_slot() {
+            DSU::Packets::Outgoing::ControllerResponseHead head{};
+            head.reporting_slot = 0;
+            head.slot_state = DSU::SlotState::CONNECTED;
+            head.device_model = DSU::DeviceModel::FULL_GYRO;
+            head.connection_type = DSU::ConnectionType::NOT_APPLICABLE;
+            head.mac_address = DSU::MacAddress{0};
+            head.battery_level = DSU::BatteryLevel::FULL;
+            return head;
+        }
+
+        uint64_t to_timestamp(clock::time_point time) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+        }
+
+        /**
+         * Writes a CONTROLLER_DATA datagram for slot 0 the way the sampling stage does, CRC included
+         * @return the length of the datagram
+         */
+        uint16_t encode_data(std::span<uint8_t, net::MAX_DATAGRAM> buffer, uint32_t packetNumber, uint64_t timestamp) {
+            DSU::Packets::Header header{};
+            header.message_type = DSU::DSUMessageType::CONTROLLER_DATA;
+            DSU::Packets::Outgoing::ControllerData data{};
+            data.beginning = connected_slot();
+            data.connected = true;
+            data.packet_number = packetNumber;
+            data.motion_data_timestamp_usec = timestamp;
+
+            OutgoingPacket packet{buffer.data(), buffer.size()};
+            packet.add_data(header);
+            packet.add_data(data);
+            packet.set_crc32();
+            return static_cast<uint16_t>(packet.cursor());
+        }
+
+        data_layout find_layout() {
+            constexpr uint32_t PACKET_NUMBER = 0x11223344;
+            constexpr uint64_t TIMESTAMP = 0x0102030405060708;
+            std::array<uint8_t, net::MAX_DATAGRAM> buffer{};
+            const auto length = encode_data(buffer, PACKET_NUMBER, TIMESTAMP);
+
+            data_layout layout{};
+            bool packetNumber = false;
+            bool timestamp = false;
+            for (size_t offset = 0; offset + sizeof(uint64_t) <= length; ++offset) {
+                if (!packetNumber && read_wire<uint32_t>(buffer.data() + offset) == PACKET_NUMBER) {
+                    layout.packet_number = offset;
+                    packetNumber = true;
+                }
+                if (!timestamp && read_wire<uint64_t>(buffer.data() + offset) == TIMESTAMP) {
+                    layout.timestamp = offset;
+                    timestamp = true;
+                }
+            }
+            if (!packetNumber || !timestamp)
+                throw std::logic_error("CONTROLLER_DATA layout not found");
+            return layout;
+        }
+
+        /**
+         * Writes a request the way a DSU client does, the header's length only covers the header but the server goes by the datagram's
+         * @return the length of the request
+         */
+        size_t encode_request(std::array<uint8_t, net::MAX_DATAGRAM>& buffer, request_kind kind, uint32_t peerId) {
+            DSU::Packets::Header header{};
+            header.magic_string = DSU::Packets::Header::CLIENT_MAGIC;
+            header.peer_id = peerId;
+            OutgoingPacket packet{buffer.data(), buffer.size()};
+            if (kind == request_kind::DATA) {
+                header.message_type = DSU::DSUMessageType::CONTROLLER_DATA;
+                packet.add_data(header);
+                // Slot based registration for slot 0, the MAC is sent either way
+                const std::array<uint8_t, DSU::Packets::Incoming::ControllerData::WIRE_SIZE> body{static_cast<uint8_t>(DSU::RegistrationType::SLOT_BASED)};
+                packet.m_writer.write(body);
+            }
+            else if (kind == request_kind::INFO) {
+                header.message_type = DSU::DSUMessageType::CONTROLLER_INFO;
+                packet.add_data(header);
+                packet.m_writer.write(SwapEndian<int32_t>(DSU::Packets::Incoming::ConnectedControllers::MAX_PORTS));
+                packet.m_writer.write(std::array<uint8_t, 4>{0, 1, 2, 3});
+            }
+            else {
+                header.message_type = DSU::DSUMessageType::PROTOCOL_VERSION;
+                packet.add_data(header);
+            }
+            packet.set_crc32();
+            return packet.cursor();
+        }
+
+        /**
+         * Virtual time a stage spends on a task, and when it is free for the next
+         */
+        struct stage_time {
+            clock::time_point free{};
+            std::chrono::nanoseconds* busy = nullptr;
+
+            void charge(clock::time_point start, std::chrono::nanoseconds cost) {
+                free = start + cost;
+                *busy += cost;
+            }
+        };
+    }
+
+    void latency_histogram::record(std::chrono::microseconds latency) {
+        const auto bucket = std::min<size_t>(std::max<int64_t>(latency.count(), 0) / BUCKET_US, BUCKETS);
+        ++counts[bucket];
+        ++total;
+        worst = std::max(worst, latency);
+    }
+
+    std::chrono::microseconds latency_histogram::percentile(double fraction) const {
+        const auto target = static_cast<uint64_t>(fraction * static_cast<double>(total));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < counts.size(); ++bucket) {
+            seen += counts[bucket];
+            if (seen > target)
+                return std::chrono::microseconds((bucket + 1) * BUCKET_US);
+        }
+        return worst;
+    }
+
+    results run(const scenario& scenario, const policy& policy, const cost_model& costs) {
+        if (scenario.clients > CAPACITY)
+            throw std::invalid_argument("clients");
+        const auto wallStart = std::chrono::steady_clock::now();
+
+        results out{};
+        virtual_clock time{};
+        memory_network network{time, scenario.latency, scenario.link_bytes_per_second, scenario.send_buffer};
+        memory_socket socket{network};
+        socket.bind(SERVER_EP);
+        auto core = std::make_unique<server>();
+        core->responses.update_slot(connected_slot());
+        const auto layout = find_layout();
+
+        const auto start = time.now();
+        const auto end = start + scenario.duration;
+
+        // The script: every client joins once, then keeps re-registering and asking for slot info on its own cadence
+        std::mt19937 random{scenario.seed};
+        std::uniform_real_distribution<double> unit{0.0, 1.0};
+        const auto jittered = [&](std::chrono::nanoseconds interval) {
+            const auto factor = 1.0 + scenario.jitter * (2.0 * unit(random) - 1.0);
+            return std::chrono::duration_cast<clock::duration>(interval * factor);
+        };
+        std::vector<simulated_client> clients(scenario.clients);
+        std::priority_queue<client_event, std::vector<client_event>, std::greater<>> events;
+        for (uint32_t index = 0; index < clients.size(); ++index) {
+            clients[index].ep = sockets::endpoint{0x0A010000 + index, CLIENT_PORT};
+            const auto joins = start + std::chrono::duration_cast<clock::duration>(scenario.join_spread * unit(random));
+            if (unit(random) < scenario.leaving)
+                clients[index].leaves = start + scenario.leave_after;
+            events.push({joins, index, request_kind::JOIN});
+        }
+
+        stage_time decode{start, &out.decode_time};
+        stage_time sampling{start, &out.sampling_time};
+        stage_time transmit{start, &out.transmit_time};
+        utils::tick_scheduler ticks{policy.sample_period, policy.overrun};
+        ticks.start(start.time_since_epoch());
+        std::deque<staged> controlOut;
+        std::deque<staged> dataOut;
+        std::array<uint8_t, net::MAX_DATAGRAM> buffer{};
+
+        while (time.now() < end) {
+            const auto now = time.now();
+
+            while (!events.empty() && events.top().time <= now) {
+                const auto event = events.top();
+                events.pop();
+                auto& client = clients[event.client];
+                if (now >= client.leaves)
+                    continue;
+                const auto send = [&](request_kind kind, uint32_t times) {
+                    const auto length = encode_request(buffer, kind, event.client);
+                    for (uint32_t i = 0; i < times; ++i)
+                        network.client_send(client.ep, SERVER_EP, {buffer.data(), length});
+                };
+                switch (event.kind) {
+                    case request_kind::JOIN:
+                        send(request_kind::JOIN, 1);
+                        send(request_kind::INFO, 1);
+                        send(request_kind::DATA, scenario.repeats);
+                        events.push({now + jittered(scenario.data_interval), event.client, request_kind::DATA});
+                        events.push({now + jittered(scenario.info_interval), event.client, request_kind::INFO});
+                        break;
+                    case request_kind::DATA:
+                        send(request_kind::DATA, scenario.repeats);
+                        events.push({now + jittered(scenario.data_interval), event.client, request_kind::DATA});
+                        break;
+                    case request_kind::INFO:
+                        send(request_kind::INFO, 1);
+                        events.push({now + jittered(scenario.info_interval), event.client, request_kind::INFO});
+                        break;
+                }
+            }
+
+            // Decode: one batch per step, each request answered from the response cache or registered
+            if (decode.free <= now) {
+                if (policy.coalesce)
+                    core->coalescer.begin_tick();
+                auto cost = std::chrono::nanoseconds::zero();
+                sockets::endpoint sender{};
+                for (size_t drained = 0; drained < policy.decode_batch; ++drained) {
+                    const auto length = socket.receive_from(buffer.data(), buffer.size(), sockets::msg_flags::DONT_WAIT, sender);
+                    if (length <= 0)
+                        break;
+                    cost += costs.decode;
+                    ++out.requests;
+
+                    if (length < static_cast<ssize_t>(DSU::Packets::Header::SIZE))
+                        continue;
+                    utils::reader reader(buffer.data(), length);
+                    DSU::Packets::Header header{};
+                    header.read(reader);
+                    header.swap_member_endian();
+                    if (!DSU::Packets::Incoming::valid(header, {buffer.data(), static_cast<size_t>(length)}))
+                        continue;
+
+                    auto* entry = core->registry.find(sender);
+                    if (entry == nullptr) {
+                        const auto index = core->registry.insert(net::client{.remote_ep = sender, .client_id = header.peer_id});
+                        entry = &core->registry.clients()[index];
+                        core->coalescer.remove(index);
+                        core->queues.reset(index, core->registry.generation(index));
+                    }
+                    entry->last_seen = now;
+                    const auto index = static_cast<uint16_t>(core->registry.clients().index_of(*entry));
+                    const auto admit = [&](const net::request_key& key) {
+                        if (policy.coalesce && !core->coalescer.admit(index, key))
+                            return false;
+                        cost += costs.handle;
+                        return true;
+                    };
+                    const auto queue = [&](const net::shared_datagram& reply) {
+                        controlOut.push_back({now + cost, index, core->registry.generation(index), sender, reply});
+                        ++out.replies;
+                    };
+
+                    if (header.message_type == DSU::DSUMessageType::PROTOCOL_VERSION) {
+                        if (admit({header.message_type}))
+                            queue(core->responses.version());
+                    }
+                    else if (header.message_type == DSU::DSUMessageType::CONTROLLER_INFO) {
+                        DSU::Packets::Incoming::ConnectedControllers request{};
+                        request.read(reader);
+                        request.swap_member_endian();
+                        for (int32_t i = 0; i < request.report_port_count; ++i) {
+                            const auto slot = request.port_id[i];
+                            if (admit({header.message_type, slot}))
+                                queue(core->responses.acquire_info(slot));
+                        }
+                    }
+                    else if (header.message_type == DSU::DSUMessageType::CONTROLLER_DATA) {
+                        DSU::Packets::Incoming::ControllerData request{};
+                        request.read(reader);
+                        request.swap_member_endian();
+                        if (admit(net::request_key::registration(request)))
+                            core->registry.subscribe(index, request, now);
+                    }
+                }
+                core->registry.expire(now);
+                core->registry.publish();
+                decode.charge(now, cost);
+            }
+
+            // Sampling: every tick that fires by now, the stage waiting on the scheduler as soon as it's free
+            while (std::max(clock::time_point{ticks.deadline()}, sampling.free) <= now) {
+                const auto tick = std::max(clock::time_point{ticks.deadline()}, sampling.free);
+                ticks.advance(sampling.free.time_since_epoch());
+
+                const auto snapshot = core->registry.read(0);
+                auto cost = std::chrono::nanoseconds::zero();
+                for (const auto& subscriber : *snapshot) {
+                    if (!subscriber.subscribed(0, tick))
+                        continue;
+                    cost += costs.encode;
+                    dataOut.push_back({tick + cost, subscriber.client, subscriber.generation, subscriber.remote_ep, {}, tick});
+                }
+                sampling.charge(tick, cost);
+            }
+
+            // Transmit: takes whatever the other stages have finished into the send queues, then sends what the socket takes
+            if (transmit.free <= now) {
+                const auto calls = network.stats().send_calls;
+                for (auto* pipe : {&controlOut, &dataOut}) {
+                    const auto kind = pipe == &controlOut ? net::datagram_kind::CONTROL : net::datagram_kind::DATA;
+                    while (!pipe->empty() && pipe->front().ready <= now) {
+                        const auto& item = pipe->front();
+                        const auto order = core->queues.compare_generation(item.client, item.generation);
+                        if (order < 0) {
+                            item.reply.release();
+                            pipe->pop_front();
+                            continue;
+                        }
+                        if (order > 0)
+                            core->queues.reset(item.client, item.generation);
+                        core->queues.set_endpoint(item.client, item.remote_ep);
+                        if (kind == net::datagram_kind::CONTROL) {
+                            core->queues.push_control(item.client, item.reply);
+                        }
+                        else {
+                            const auto target = core->queues.reserve(item.client, kind);
+                            auto& sequence = core->sequences[item.client];
+                            if (sequence.generation != item.generation)
+                                sequence = data_sequence{item.generation, 0};
+                            core->queues.commit(item.client, kind, encode_data(target, ++sequence.packet_number, to_timestamp(item.sample)));
+                            ++out.encodes;
+                        }
+                        pipe->pop_front();
+                    }
+                }
+                const auto sent = core->queues.flush(socket);
+                const auto cost = costs.send_call * (network.stats().send_calls - calls) + costs.send_datagram * sent;
+                transmit.charge(now, cost);
+            }
+
+            network.deliver([&](const datagram& datagram) {
+                const auto index = datagram.to.address_value() - 0x0A010000;
+                if (index >= clients.size())
+                    return;
+                auto& client = clients[index];
+                if (read_wire<DSU::DSUMessageType>(datagram.data.data() + 16) != DSU::DSUMessageType::CONTROLLER_DATA)
+                    return;
+                ++out.delivered;
+                const auto packetNumber = read_wire<uint32_t>(datagram.data.data() + layout.packet_number);
+                if (packetNumber > client.last_packet + 1)
+                    out.missed += packetNumber - client.last_packet - 1;
+                client.last_packet = std::max(client.last_packet, packetNumber);
+                const auto sample = std::chrono::microseconds(read_wire<uint64_t>(datagram.data.data() + layout.timestamp));
+                out.latency.record(std::chrono::duration_cast<std::chrono::microseconds>(datagram.arrival.time_since_epoch()) - sample);
+            });
+
+            time.advance(policy.step);
+        }
+
+        out.coalesced = core->coalescer.stats().coalesced;
+        out.send_calls = network.stats().send_calls;
+        out.refused = network.stats().refused;
+        for (size_t index = 0; index < CAPACITY; ++index) {
+            const auto& stats = core->queues.stats(index);
+            out.dropped_stale += stats.dropped_stale;
+            out.dropped_control += stats.dropped_control;
+        }
+        const auto& tickStats = ticks.stats();
+        out.ticks = tickStats.ticks;
+        for (const auto overruns : tickStats.overruns)
+            out.overruns += overruns;
+        out.skipped = tickStats.skipped;
+        out.wall_time = std::chrono::steady_clock::now() - wallStart;
+        return out;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "../src/utils/tick_scheduler.h"
+
+namespace sim {
+    using namespace std::chrono_literals;
+
+    /**
+     * The clients and the network a run is played against, generated from a seed so every policy sees the same requests
+     */
+    struct scenario {
+        const char* name = "";
+        size_t clients = 1000;
+        std::chrono::nanoseconds duration = 10s;
+        // Clients join at random times within this
+        std::chrono::nanoseconds join_spread = 1s;
+        // How often each client re-sends its data registration, and by how much it varies either way, as a fraction
+        std::chrono::nanoseconds data_interval = 1s;
+        double jitter = 0.1;
+        // Each registration is sent this many times back to back, as some clients do
+        uint32_t repeats = 1;
+        std::chrono::nanoseconds info_interval = 5s;
+        // Fraction of clients that go quiet after leave_after and let their registration lapse
+        double leaving = 0;
+        std::chrono::nanoseconds leave_after = 2s;
+        std::chrono::nanoseconds latency = 200us;
+        double link_bytes_per_second = 12.5e6;
+        double send_buffer = 212992;
+        uint32_t seed = 1;
+    };
+
+    /**
+     * Virtual CPU time charged for each unit of work, a stand-in for what the console spends on it
+     */
+    struct cost_model {
+        std::chrono::nanoseconds decode = 3us;
+        // On top of decoding, for each request that wasn't coalesced away
+        std::chrono::nanoseconds handle = 2us;
+        std::chrono::nanoseconds encode = 6us;
+        std::chrono::nanoseconds send_call = 15us;
+        std::chrono::nanoseconds send_datagram = 2us;
+    };
+
+    /**
+     * The scheduling choices under comparison
+     */
+    struct policy {
+        const char* name = "";
+        std::chrono::nanoseconds sample_period = 4ms;
+        utils::overrun_policy overrun = utils::overrun_policy::SKIP;
+        bool coalesce = true;
+        // How often the decode and transmit stages look for work, also the simulation's step
+        std::chrono::nanoseconds step = 250us;
+        // Datagrams decoded per step
+        size_t decode_batch = 32;
+    };
+
+    /**
+     * Latencies from a sample being taken to its datagram reaching a client, in 10 microsecond buckets
+     */
+    struct latency_histogram {
+        static constexpr uint32_t BUCKET_US = 10;
+        static constexpr size_t BUCKETS = 10000;
+
+        std::array<uint64_t, BUCKETS + 1> counts{};
+        uint64_t total = 0;
+        std::chrono::microseconds worst{};
+
+        void record(std::chrono::microseconds latency);
+
+        /**
+         * @param fraction 0.5 for the median
+         * @return the upper bound of the bucket the fraction falls in
+         */
+        [[nodiscard]] std::chrono::microseconds percentile(double fraction) const;
+    };
+
+    struct results {
+        // Work the server did, and the virtual CPU time each stage spent on it
+        uint64_t requests = 0;
+        uint64_t coalesced = 0;
+        uint64_t replies = 0;
+        uint64_t encodes = 0;
+        uint64_t send_calls = 0;
+        std::chrono::nanoseconds decode_time{};
+        std::chrono::nanoseconds sampling_time{};
+        std::chrono::nanoseconds transmit_time{};
+
+        uint64_t ticks = 0;
+        uint64_t overruns = 0;
+        uint64_t skipped = 0;
+
+        uint64_t delivered = 0;
+        latency_histogram latency{};
+        // Samples superseded in a send queue before they went out
+        uint64_t dropped_stale = 0;
+        uint64_t dropped_control = 0;
+        // Datagrams the send buffer had no room for, they stay queued and may go stale
+        uint64_t refused = 0;
+        // Packet numbers clients never saw
+        uint64_t missed = 0;
+
+        // Host time the run took, to compare with the simulated duration
+        std::chrono::nanoseconds wall_time{};
+    };
+
+    /**
+     * Plays a scenario against the server's registry, coalescer and send queues under a policy, entirely in virtual time
+     */
+    results run(const scenario& scenario, const policy& policy, const cost_model& costs = {});
+}
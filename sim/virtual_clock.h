@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+
+namespace sim {
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * Time that only moves when the harness moves it. Uses steady_clock's types, so the server's components take it unchanged.
+     */
+    class virtual_clock {
+        // Away from zero, the server treats a default time point as never
+        clock::time_point m_now{std::chrono::seconds(1)};
+    public:
+        [[nodiscard]] clock::time_point now() const {
+            return m_now;
+        }
+
+        void advance(clock::duration duration) {
+            m_now += duration;
+        }
+    };
+}
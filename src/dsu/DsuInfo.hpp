@@ -1,5 +1,7 @@
 #pragma once
-#include <wut_types.h>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <array>
 #include <cstring>
@@ -9,6 +11,14 @@ namespace DSU {
         PROTOCOL_VERSION = 0x100000,
         CONTROLLER_INFO = 0x100001,
         CONTROLLER_DATA = 0X100002,
+        // Server extensions, plain DSU clients never send these
+        MULTICAST_GROUP = 0x100008,
+        // Negotiates MOTION_BATCH_DATA in place of CONTROLLER_DATA for a client that understands it
+        MOTION_BATCH = 0x100009,
+        MOTION_BATCH_DATA = 0x10000A,
+        // Motor extension, sent by clients that drive rumble
+        PORT_MOTOR_INFO = 0x110001,
+        RUMBLE = 0x110002,
         INVALID = 0xFFFFFFFF
     };
     enum class SlotState : uint8_t{
@@ -107,7 +117,11 @@ namespace DSU {
         MacAddress() : m_data(){
             m_data.fill(0);
         }
+        bool operator==(const MacAddress&) const = default;
+
         void SwapEndian(){
+            if constexpr (std::endian::native == std::endian::little)
+                return;
             constexpr auto length = 6;
             uint8_t temp;
             for (int i = 0; i < length / 2; i++)
@@ -1,8 +1,13 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <span>
+
 #include "../utils/letype.hpp"
 #include "../utils/reader.hpp"
 #include "../utils/writer.hpp"
 #include "../utils/crc.hpp"
-#include "../utils/h_array.hpp"
+#include "../utils/trace.hpp"
 
 #include "DsuInfo.hpp"
 
@@ -32,8 +37,14 @@ namespace DSU::Packets {
     };
 
     struct Header : PacketData {
+        static constexpr size_t SIZE = 20;
+        static constexpr size_t CRC_OFFSET = 8;
+        static constexpr uint16_t PROTOCOL_VERSION = 1001u;
+        // What clients put in magic_string, replies carry the default
+        static constexpr std::array<char, 4> CLIENT_MAGIC = {'D', 'S', 'U', 'C'};
+
         std::array<char, 4> magic_string = {'D', 'S', 'U', 'S'};
-        uint16_t protocol_version = 1001u;
+        uint16_t protocol_version = PROTOCOL_VERSION;
         uint16_t packet_length;
         uint32_t crc_32;
         uint32_t peer_id{};
@@ -75,34 +86,61 @@ namespace DSU::Packets {
         }
 
         [[nodiscard]] constexpr size_t size() const override {
-            return 24;
+            return SIZE;
         }
     };
     namespace Incoming {
+        /**
+         * Whether a received datagram is a request from a DSU client at all: the client magic, the protocol version this
+         * server speaks and the CRC of its contents
+         * @param header the datagram's header, already read and swapped, so the datagram must be at least Header::SIZE long
+         * @param datagram the whole datagram, its CRC field is zeroed to compute the CRC and put back after
+         */
+        inline bool valid(const Header& header, std::span<uint8_t> datagram) {
+            if (header.magic_string != Header::CLIENT_MAGIC || header.protocol_version != Header::PROTOCOL_VERSION)
+                return false;
+
+            TRACE_SCOPE("crc");
+            auto* const field = datagram.data() + Header::CRC_OFFSET;
+            std::array<uint8_t, sizeof(uint32_t)> received{};
+            std::copy_n(field, received.size(), received.begin());
+            std::fill_n(field, received.size(), 0);
+            const auto crc = utils::crc(datagram.begin(), datagram.end());
+            std::copy(received.begin(), received.end(), field);
+            return crc == header.crc_32;
+        }
+
         struct ConnectedControllers : PacketData {
-            int32_t report_port_count;
-            utils::h_array<uint8_t> port_id;
+            static constexpr int32_t MAX_PORTS = 4;
+
+            int32_t report_port_count{};
+            std::array<uint8_t, MAX_PORTS> port_id{};
 
             void swap_member_endian() override {
                 report_port_count = SwapEndian(report_port_count);
             }
 
+            // The count is still in wire order here, it's swapped locally to know how many ids follow
             void read(utils::reader &reader) override {
                 reader.read(report_port_count);
-                reader.read(port_id.begin(), report_port_count);
+                const auto count = std::clamp(SwapEndian(report_port_count), 0, MAX_PORTS);
+                reader.read(port_id.begin(), count);
             }
 
             void write(utils::writer &writer) const override {
                 writer.write(report_port_count);
-                writer.write(port_id.cbegin(), port_id.size());
+                writer.write(port_id.cbegin(), std::clamp(report_port_count, 0, MAX_PORTS));
             }
 
             [[nodiscard]] size_t size() const override {
-                return sizeof(report_port_count) + report_port_count;
+                return sizeof(report_port_count) + std::clamp(report_port_count, 0, MAX_PORTS);
             }
         };
 
         struct ControllerData : PacketData {
+            // The slot and MAC are always sent, whatever the registration type
+            static constexpr size_t WIRE_SIZE = 8;
+
             RegistrationType registration_type{};
             uint8_t reporting_slot{};
             MacAddress mac_address;
@@ -129,6 +167,55 @@ namespace DSU::Packets {
                 return size;
             }
         };
+
+        struct MotionBatch : PacketData {
+            static constexpr size_t WIRE_SIZE = 9;
+
+            // Picks the slots the same way a CONTROLLER_DATA registration does, the request registers for them too
+            ControllerData target;
+            // Most motion samples the client takes per datagram, below 2 asks for plain CONTROLLER_DATA
+            uint8_t max_samples{};
+
+            void swap_member_endian() override {
+                target.swap_member_endian();
+            }
+
+            void read(utils::reader &reader) override {
+                target.read(reader);
+                reader.read(max_samples);
+            }
+
+            void write(utils::writer &) const override {}
+
+            [[nodiscard]] constexpr size_t size() const override {
+                return WIRE_SIZE;
+            }
+        };
+
+        struct Rumble : PacketData {
+            static constexpr size_t WIRE_SIZE = 10;
+
+            // Picks the slot the same way a CONTROLLER_DATA registration does
+            ControllerData target;
+            uint8_t motor_id{};
+            uint8_t intensity{};
+
+            void swap_member_endian() override {
+                target.swap_member_endian();
+            }
+
+            void read(utils::reader &reader) override {
+                target.read(reader);
+                reader.read(motor_id);
+                reader.read(intensity);
+            }
+
+            void write(utils::writer &) const override {}
+
+            [[nodiscard]] constexpr size_t size() const override {
+                return WIRE_SIZE;
+            }
+        };
     }
 
     namespace Outgoing {
@@ -342,11 +429,136 @@ namespace DSU::Packets {
                 return 2;
             }
         };
+        struct MotorInfo : PacketData {
+            ControllerResponseHead head;
+            uint8_t motor_count = 0;
+
+            void read(utils::reader &reader) override {
+                head.read(reader);
+                reader.read(motor_count);
+            }
+
+            void write(utils::writer &writer) const override {
+                head.write(writer);
+                writer.write(motor_count);
+            }
+
+            void swap_member_endian() override {
+                head.swap_member_endian();
+            }
+
+            [[nodiscard]] constexpr size_t size() const override {
+                return 12;
+            }
+        };
+
+        struct MotionBatchAccept : PacketData {
+            // Samples per MOTION_BATCH_DATA datagram from now on, 0 when the client gets plain CONTROLLER_DATA
+            uint8_t samples = 0;
+
+            void swap_member_endian() override {}
+
+            void read(utils::reader &reader) override {
+                reader.read(samples);
+            }
+
+            void write(utils::writer &writer) const override {
+                writer.write(samples);
+            }
+
+            [[nodiscard]] constexpr size_t size() const override {
+                return 1;
+            }
+        };
+
+        struct MotionSample {
+            uint64_t timestamp_usec{};
+            struct {
+                float x;
+                float y;
+                float z;
+            } accelerometer{};
+            struct {
+                float pitch;
+                float yaw;
+                float roll;
+            } gyroscope{};
+        };
+
+        /**
+         * Follows a full ControllerData in a MOTION_BATCH_DATA datagram, the motion samples since the previous datagram, oldest first
+         */
+        struct MotionSamples : PacketData {
+            static constexpr uint8_t MAX_SAMPLES = 4;
+
+            uint8_t count = 0;
+            std::array<MotionSample, MAX_SAMPLES> samples{};
+
+            void swap_member_endian() override {
+                for (size_t i = 0; i < std::min(count, MAX_SAMPLES); ++i) {
+                    auto& sample = samples[i];
+                    sample.timestamp_usec = SwapEndian(sample.timestamp_usec);
+                    sample.accelerometer.x = SwapEndian(sample.accelerometer.x);
+                    sample.accelerometer.y = SwapEndian(sample.accelerometer.y);
+                    sample.accelerometer.z = SwapEndian(sample.accelerometer.z);
+                    sample.gyroscope.pitch = SwapEndian(sample.gyroscope.pitch);
+                    sample.gyroscope.yaw = SwapEndian(sample.gyroscope.yaw);
+                    sample.gyroscope.roll = SwapEndian(sample.gyroscope.roll);
+                }
+            }
+
+            void read(utils::reader &) override {}
+
+            void write(utils::writer &writer) const override {
+                writer.write(count);
+                for (size_t i = 0; i < std::min(count, MAX_SAMPLES); ++i) {
+                    writer.write(samples[i].timestamp_usec);
+                    writer.write(samples[i].accelerometer);
+                    writer.write(samples[i].gyroscope);
+                }
+            }
+
+            [[nodiscard]] size_t size() const override {
+                return 1 + std::min(count, MAX_SAMPLES) * 32;
+            }
+        };
+
+        struct MulticastGroup : PacketData {
+            // Network order, as the client passes it straight to IP_ADD_MEMBERSHIP
+            std::array<uint8_t, 4> address{};
+            uint16_t port{};
+            uint8_t ttl{};
+            // 0 when the server isn't publishing, the client should keep using unicast
+            uint8_t enabled{};
+
+            void swap_member_endian() override {
+                port = SwapEndian(port);
+            }
+
+            void read(utils::reader &reader) override {
+                reader.read(address);
+                reader.read(port);
+                reader.read(ttl);
+                reader.read(enabled);
+            }
+
+            void write(utils::writer &writer) const override {
+                writer.write(address);
+                writer.write(port);
+                writer.write(ttl);
+                writer.write(enabled);
+            }
+
+            [[nodiscard]] constexpr size_t size() const override {
+                return 8;
+            }
+        };
+
         struct OutgoingPacket {
             utils::writer m_writer;
             static constexpr size_t LENGTH_OFFSET = 6;
 
-            static constexpr size_t CRC_OFFSET = 8;
+            static constexpr size_t CRC_OFFSET = Header::CRC_OFFSET;
 
             explicit OutgoingPacket(uint8_t* data, size_t size)
             : m_writer(data, size) {}
@@ -367,6 +579,7 @@ namespace DSU::Packets {
                 m_writer.seek(posCur);
             }
             void set_crc32(){
+                TRACE_SCOPE("crc");
                 const auto posCur = m_writer.pos();
 
                 m_writer.seek(CRC_OFFSET);
@@ -0,0 +1,137 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+namespace DSU {
+    enum class InputChannel : uint8_t {
+        ACCEL_X,
+        ACCEL_Y,
+        ACCEL_Z,
+        GYRO_PITCH,
+        GYRO_YAW,
+        GYRO_ROLL,
+        LEFT_STICK_X,
+        LEFT_STICK_Y,
+        RIGHT_STICK_X,
+        RIGHT_STICK_Y,
+        COUNT
+    };
+
+    /**
+     * The continuous part of one input sample, buttons aren't predicted
+     */
+    struct InputSample {
+        std::chrono::steady_clock::time_point time{};
+        std::array<float, static_cast<size_t>(InputChannel::COUNT)> values{};
+
+        float& operator[](InputChannel channel) {
+            return values[static_cast<size_t>(channel)];
+        }
+
+        float operator[](InputChannel channel) const {
+            return values[static_cast<size_t>(channel)];
+        }
+    };
+
+    /**
+     * Extrapolates the newest input sample a short way into the future, so a client gets roughly what the controller
+     * reads at the moment it consumes the packet rather than when it was encoded.
+     * Each channel follows the least squares slope of the last few samples. The horizon is capped, and no channel moves
+     * further from the newest sample than the spread of the history, so a noisy or stale history can't overshoot.
+     */
+    class InputPredictor {
+        using clock = std::chrono::steady_clock;
+        static constexpr size_t HISTORY = 4;
+        static constexpr size_t CHANNELS = static_cast<size_t>(InputChannel::COUNT);
+
+        std::array<InputSample, HISTORY> m_history{};
+        size_t m_count = 0;
+        size_t m_next = 0;
+    public:
+        // Longest extrapolation, beyond this a linear guess is worse than a late sample
+        static constexpr auto MAX_HORIZON = std::chrono::milliseconds(16);
+        // Samples further apart than this are treated as a new history, the controller stopped reporting in between
+        static constexpr auto MAX_GAP = std::chrono::milliseconds(50);
+
+        /**
+         * Adds the newest sample, restarting the history if the previous one is too old to extrapolate from
+         */
+        void push(const InputSample& sample) {
+            if (m_count != 0 && sample.time - newest().time > MAX_GAP)
+                m_count = 0;
+            m_history[m_next] = sample;
+            m_next = (m_next + 1) % HISTORY;
+            m_count = std::min(m_count + 1, HISTORY);
+        }
+
+        /**
+         * @param target when the sample will be consumed
+         * @return the newest sample moved forward to the target, or unchanged if there isn't enough history
+         */
+        [[nodiscard]] InputSample predict(clock::time_point target) const {
+            auto predicted = newest();
+            if (m_count < 2 || target <= predicted.time)
+                return predicted;
+            const auto horizon = std::chrono::duration<float>(std::min<clock::duration>(target - predicted.time, MAX_HORIZON)).count();
+
+            // Times relative to the newest sample keep the sums small
+            std::array<float, HISTORY> times{};
+            float meanTime = 0;
+            for (size_t i = 0; i < m_count; ++i) {
+                times[i] = std::chrono::duration<float>(at(i).time - predicted.time).count();
+                meanTime += times[i];
+            }
+            meanTime /= static_cast<float>(m_count);
+            float timeVariance = 0;
+            for (size_t i = 0; i < m_count; ++i)
+                timeVariance += (times[i] - meanTime) * (times[i] - meanTime);
+            if (timeVariance <= 0)
+                return predicted;
+
+            for (size_t channel = 0; channel < CHANNELS; ++channel) {
+                float mean = 0;
+                float low = predicted.values[channel];
+                float high = low;
+                for (size_t i = 0; i < m_count; ++i) {
+                    const auto value = at(i).values[channel];
+                    mean += value;
+                    low = std::min(low, value);
+                    high = std::max(high, value);
+                }
+                mean /= static_cast<float>(m_count);
+                float covariance = 0;
+                for (size_t i = 0; i < m_count; ++i)
+                    covariance += (times[i] - meanTime) * (at(i).values[channel] - mean);
+
+                const auto spread = high - low;
+                const auto step = std::clamp(covariance / timeVariance * horizon, -spread, spread);
+                predicted.values[channel] += step;
+            }
+            // Sticks can't go past their full deflection
+            for (const auto channel : {InputChannel::LEFT_STICK_X, InputChannel::LEFT_STICK_Y, InputChannel::RIGHT_STICK_X, InputChannel::RIGHT_STICK_Y})
+                predicted[channel] = std::clamp(predicted[channel], -1.0f, 1.0f);
+            predicted.time = target;
+            return predicted;
+        }
+
+        void clear() {
+            m_count = 0;
+        }
+
+    private:
+        [[nodiscard]] const InputSample& newest() const {
+            return m_history[(m_next + HISTORY - 1) % HISTORY];
+        }
+
+        /**
+         * @param age 0 for the newest sample
+         */
+        [[nodiscard]] const InputSample& at(size_t age) const {
+            return m_history[(m_next + HISTORY - 1 - age) % HISTORY];
+        }
+    };
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace DSU {
+    using Vector3 = std::array<float, 3>;
+    // Row major
+    using Matrix3 = std::array<float, 9>;
+
+    constexpr Matrix3 IDENTITY{1, 0, 0, 0, 1, 0, 0, 0, 1};
+
+    /**
+     * Which raw axis feeds each output axis, and with which sign
+     */
+    struct AxisMapping {
+        std::array<uint8_t, 3> source;
+        Vector3 sign;
+    };
+
+    /**
+     * out = matrix * raw + offset, everything a sensor needs folded into one affine transform
+     */
+    struct AxisTransform {
+        Matrix3 matrix = IDENTITY;
+        Vector3 offset{};
+
+        /**
+         * Folds the steps applied to a raw reading, in order: bias removal, axis remapping, unit scaling, mounting rotation
+         * @param axes the remapping from the sensor's axes to DSU's
+         * @param scale converts the sensor's units to DSU's
+         * @param mounting rotates DSU axes of the sensor into DSU axes of the controller
+         * @param bias what the sensor reads at rest, in raw units
+         */
+        static constexpr AxisTransform compose(const AxisMapping& axes, float scale, const Matrix3& mounting, const Vector3& bias) {
+            Matrix3 remap{};
+            for (size_t row = 0; row < 3; ++row)
+                remap[row * 3 + axes.source[row]] = axes.sign[row] * scale;
+
+            AxisTransform transform{};
+            for (size_t row = 0; row < 3; ++row) {
+                for (size_t column = 0; column < 3; ++column) {
+                    float sum = 0;
+                    for (size_t i = 0; i < 3; ++i)
+                        sum += mounting[row * 3 + i] * remap[i * 3 + column];
+                    transform.matrix[row * 3 + column] = sum;
+                }
+            }
+            for (size_t row = 0; row < 3; ++row) {
+                transform.offset[row] = -(transform.matrix[row * 3] * bias[0] + transform.matrix[row * 3 + 1] * bias[1] + transform.matrix[row * 3 + 2] * bias[2]);
+            }
+            return transform;
+        }
+
+        /**
+         * Straight line arithmetic with no branches, the compiler turns it into a handful of multiply-adds
+         */
+        [[nodiscard]] Vector3 apply(const Vector3& raw) const {
+            Vector3 out;
+            for (size_t row = 0; row < 3; ++row)
+                out[row] = matrix[row * 3] * raw[0] + matrix[row * 3 + 1] * raw[1] + matrix[row * 3 + 2] * raw[2] + offset[row];
+            return out;
+        }
+    };
+
+    /**
+     * Turns raw GamePad motion readings into what DSU clients expect: acceleration in g and angular velocity in degrees per second,
+     * on DSU's axes, with the gyro's bias at rest removed. Recomposed only when the bias or mounting changes, each sample costs two transforms.
+     */
+    class MotionCalibration {
+        Vector3 m_gyro_bias{};
+        Matrix3 m_mounting = IDENTITY;
+        AxisTransform m_accelerometer{};
+        AxisTransform m_gyroscope{};
+    public:
+        // VPAD reports angular velocity in revolutions per second
+        static constexpr float GYRO_SCALE = 360.0f;
+        // VPAD already reports acceleration in g
+        static constexpr float ACCELEROMETER_SCALE = 1.0f;
+        static constexpr AxisMapping ACCELEROMETER_AXES{{0, 1, 2}, {1, 1, 1}};
+        // Pitch from x, yaw from y, roll from z
+        static constexpr AxisMapping GYROSCOPE_AXES{{0, 1, 2}, {1, 1, 1}};
+
+        MotionCalibration() {
+            recompose();
+        }
+
+        /**
+         * @param bias what the gyro reads at rest, in raw units
+         */
+        void set_gyro_bias(const Vector3& bias) {
+            m_gyro_bias = bias;
+            recompose();
+        }
+
+        /**
+         * @param mounting rotates the GamePad's DSU axes into the ones clients should see, for a GamePad mounted in a rig
+         */
+        void set_mounting(const Matrix3& mounting) {
+            m_mounting = mounting;
+            recompose();
+        }
+
+        [[nodiscard]] const Vector3& gyro_bias() const {
+            return m_gyro_bias;
+        }
+
+        [[nodiscard]] const Matrix3& mounting() const {
+            return m_mounting;
+        }
+
+        /**
+         * Calibrates one sample in place
+         */
+        void apply(Vector3& accelerometer, Vector3& gyroscope) const {
+            accelerometer = m_accelerometer.apply(accelerometer);
+            gyroscope = m_gyroscope.apply(gyroscope);
+        }
+
+    private:
+        void recompose() {
+            m_accelerometer = AxisTransform::compose(ACCELEROMETER_AXES, ACCELEROMETER_SCALE, m_mounting, {});
+            m_gyroscope = AxisTransform::compose(GYROSCOPE_AXES, GYRO_SCALE, m_mounting, m_gyro_bias);
+        }
+    };
+
+    /**
+     * Measures the gyro's bias whenever the GamePad lies still for a full window, in raw units
+     */
+    class GyroBiasEstimator {
+        Vector3 m_sum{};
+        Vector3 m_low{};
+        Vector3 m_high{};
+        size_t m_count = 0;
+    public:
+        // About a second at the default sample rate
+        static constexpr size_t WINDOW = 256;
+        // How much each gyro axis may wander over the window, about 1 degree per second
+        static constexpr float MAX_SPREAD = 0.003f;
+        // A bias this large is the GamePad turning slowly rather than drift, about 10 degrees per second
+        static constexpr float MAX_BIAS = 0.03f;
+        // How far acceleration may stray from gravity while lying still
+        static constexpr float MAX_ACCELERATION_ERROR = 0.05f;
+
+        /**
+         * @param accelerometer the raw acceleration, in g
+         * @param gyroscope the raw angular velocity
+         * @return the mean gyro reading once a full window was still, then starts over
+         */
+        std::optional<Vector3> push(const Vector3& accelerometer, const Vector3& gyroscope) {
+            const auto gravity = std::sqrt(accelerometer[0] * accelerometer[0] + accelerometer[1] * accelerometer[1] + accelerometer[2] * accelerometer[2]);
+            if (std::abs(gravity - 1.0f) > MAX_ACCELERATION_ERROR) {
+                m_count = 0;
+                return std::nullopt;
+            }
+            if (m_count == 0) {
+                m_sum = {};
+                m_low = gyroscope;
+                m_high = gyroscope;
+            }
+            for (size_t axis = 0; axis < 3; ++axis) {
+                m_sum[axis] += gyroscope[axis];
+                m_low[axis] = std::min(m_low[axis], gyroscope[axis]);
+                m_high[axis] = std::max(m_high[axis], gyroscope[axis]);
+                if (m_high[axis] - m_low[axis] > MAX_SPREAD) {
+                    m_count = 0;
+                    return std::nullopt;
+                }
+            }
+            if (++m_count < WINDOW)
+                return std::nullopt;
+
+            m_count = 0;
+            Vector3 bias{};
+            for (size_t axis = 0; axis < 3; ++axis) {
+                bias[axis] = m_sum[axis] / static_cast<float>(WINDOW);
+                if (std::abs(bias[axis]) > MAX_BIAS)
+                    return std::nullopt;
+            }
+            return bias;
+        }
+    };
+}
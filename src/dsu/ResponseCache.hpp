@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <span>
+
+#include "DsuPacket.hpp"
+#include "../net/shared_datagram.hpp"
+
+namespace DSU {
+    enum class SlotUpdate {
+        UNCHANGED,
+        CHANGED,
+        // Every spare buffer is still queued to be sent, try again later
+        DEFERRED
+    };
+
+    /**
+     * Ready to send PROTOCOL_VERSION and CONTROLLER_INFO replies, CRC included, sent straight from the cache.
+     * The version reply never changes, a slot's info reply is re-encoded only when what it reports changes, into a buffer
+     * no send queue points at any more.
+     */
+    class ResponseCache {
+        static constexpr size_t VERSION_LENGTH = 22;
+        static constexpr size_t INFO_LENGTH = 32;
+        static constexpr size_t SLOTS = Packets::Incoming::ConnectedControllers::MAX_PORTS;
+        // The current reply and the ones earlier versions of it can still be queued in
+        static constexpr size_t INFO_BUFFERS = 4;
+
+        struct InfoBuffer {
+            std::array<uint8_t, INFO_LENGTH> data{};
+            std::atomic<uint32_t> users{0};
+        };
+
+        std::array<uint8_t, VERSION_LENGTH> m_version{};
+        std::array<std::array<InfoBuffer, INFO_BUFFERS>, SLOTS> m_info{};
+        std::array<uint8_t, SLOTS> m_current{};
+        std::array<Packets::Outgoing::ControllerResponseHead, SLOTS> m_heads{};
+    public:
+        static constexpr uint16_t MAX_PROTOCOL_VERSION = 1001;
+
+        ResponseCache() {
+            Packets::Header header{};
+            header.message_type = DSUMessageType::PROTOCOL_VERSION;
+            Packets::Outgoing::VersionInfo versionInfo{};
+            versionInfo.max_protocol_version = MAX_PROTOCOL_VERSION;
+
+            Packets::Outgoing::OutgoingPacket packet{m_version.data(), m_version.size()};
+            packet.add_data(header);
+            packet.add_data(versionInfo);
+            packet.set_crc32();
+
+            for (uint8_t slot = 0; slot < SLOTS; ++slot) {
+                m_heads[slot].reporting_slot = slot;
+                m_heads[slot].slot_state = SlotState::DISCONNECTED;
+                encode_info(slot, 0);
+            }
+        }
+
+        /**
+         * Re-encodes a slot's info reply if anything it reports has changed
+         * @param head the current description of the slot, its reporting_slot picks the entry
+         * @return DEFERRED when every buffer the reply could go into is still queued somewhere
+         */
+        SlotUpdate update_slot(const Packets::Outgoing::ControllerResponseHead& head) {
+            if (head.reporting_slot >= SLOTS)
+                return SlotUpdate::UNCHANGED;
+            const auto slot = head.reporting_slot;
+            if (same_state(m_heads[slot], head))
+                return SlotUpdate::UNCHANGED;
+            for (size_t i = 1; i < INFO_BUFFERS; ++i) {
+                const auto next = static_cast<uint8_t>((m_current[slot] + i) % INFO_BUFFERS);
+                if (m_info[slot][next].users.load(std::memory_order_acquire) != 0)
+                    continue;
+                m_heads[slot] = head;
+                encode_info(slot, next);
+                m_current[slot] = next;
+                return SlotUpdate::CHANGED;
+            }
+            return SlotUpdate::DEFERRED;
+        }
+
+        /**
+         * @return whether two descriptions of a slot would encode the same info reply
+         */
+        static bool same_state(const Packets::Outgoing::ControllerResponseHead& a, const Packets::Outgoing::ControllerResponseHead& b) {
+            return a.reporting_slot == b.reporting_slot && a.slot_state == b.slot_state && a.device_model == b.device_model &&
+                   a.connection_type == b.connection_type && a.mac_address == b.mac_address && a.battery_level == b.battery_level;
+        }
+
+        [[nodiscard]] net::shared_datagram version() const {
+            return {m_version};
+        }
+
+        /**
+         * Counts a send queue entry against the slot's current info reply, the buffer isn't rewritten until it's released
+         * @param slot a slot below ConnectedControllers::MAX_PORTS
+         * @return the CONTROLLER_INFO reply for the slot
+         */
+        [[nodiscard]] net::shared_datagram acquire_info(uint8_t slot) {
+            auto& buffer = m_info[slot][m_current[slot]];
+            buffer.users.fetch_add(1, std::memory_order_relaxed);
+            return {buffer.data, &buffer.users};
+        }
+
+        /**
+         * @param slot a slot below ConnectedControllers::MAX_PORTS
+         * @return what the cached info reply for the slot reports
+         */
+        [[nodiscard]] const Packets::Outgoing::ControllerResponseHead& head(uint8_t slot) const {
+            return m_heads[slot];
+        }
+
+    private:
+        void encode_info(uint8_t slot, uint8_t index) {
+            Packets::Header header{};
+            header.message_type = DSUMessageType::CONTROLLER_INFO;
+            Packets::Outgoing::ConnectedControllers body{};
+            // add_data swaps in place, the cached head has to stay in host order for comparisons
+            body.head = m_heads[slot];
+            body.tail = '\0';
+
+            auto& buffer = m_info[slot][index].data;
+            Packets::Outgoing::OutgoingPacket packet{buffer.data(), buffer.size()};
+            packet.add_data(header);
+            packet.add_data(body);
+            packet.set_crc32();
+        }
+    };
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "../net/subscriptions.hpp"
+
+namespace DSU {
+    /**
+     * On/off bits for VPADControlMotor, which has no intensity of its own, so intensity becomes how many bits are on
+     */
+    struct MotorPattern {
+        static constexpr size_t BITS = 120;
+
+        std::array<uint8_t, BITS / 8> bits{};
+
+        /**
+         * @param intensity 0 to 255, the on bits are spread as evenly as possible and any intensity above 0 sets the first
+         */
+        static MotorPattern from_intensity(uint8_t intensity) {
+            MotorPattern pattern{};
+            uint32_t accumulated = intensity == 0 ? 0 : UINT8_MAX - intensity;
+            for (size_t bit = 0; bit < BITS; ++bit) {
+                accumulated += intensity;
+                if (accumulated >= UINT8_MAX) {
+                    accumulated -= UINT8_MAX;
+                    pattern.bits[bit / 8] |= static_cast<uint8_t>(0x80u >> (bit % 8));
+                }
+            }
+            return pattern;
+        }
+    };
+
+    /**
+     * The rumble clients have asked for on one slot.
+     * Clients repeat a command for as long as an effect plays, a slot that stops hearing them is turned off.
+     */
+    class RumbleSlot {
+        using clock = std::chrono::steady_clock;
+
+        uint8_t m_intensity = 0;
+        clock::time_point m_expiry{};
+        clock::time_point m_next_refresh{};
+    public:
+        static constexpr auto TIMEOUT = net::subscription_index<>::TIMEOUT;
+        // A motor pattern plays once, it's sent again this often while the slot rumbles
+        static constexpr auto REFRESH = std::chrono::milliseconds(100);
+        // Period of the on/off modulation used for motors that can only be switched
+        static constexpr auto SWITCH_PERIOD = std::chrono::milliseconds(20);
+
+        /**
+         * @param intensity 0 stops the motor
+         * @param now the time the command was received
+         * @return whether the intensity changed, the motor needs updating straight away if so
+         */
+        bool set(uint8_t intensity, clock::time_point now) {
+            m_expiry = now + TIMEOUT;
+            if (intensity == m_intensity)
+                return false;
+            m_intensity = intensity;
+            m_next_refresh = now + REFRESH;
+            return true;
+        }
+
+        /**
+         * Stops the slot once its last command has lapsed
+         * @return whether it was rumbling until now
+         */
+        bool expire(clock::time_point now) {
+            if (m_intensity == 0 || now < m_expiry)
+                return false;
+            m_intensity = 0;
+            return true;
+        }
+
+        /**
+         * @return whether the motor pattern has to be sent again
+         */
+        bool refresh_due(clock::time_point now) {
+            if (m_intensity == 0 || now < m_next_refresh)
+                return false;
+            m_next_refresh = now + REFRESH;
+            return true;
+        }
+
+        /**
+         * @return whether a switched motor should be on at this point of the modulation period
+         */
+        [[nodiscard]] bool switched_on(clock::time_point now) const {
+            if (m_intensity == 0)
+                return false;
+            const auto phase = now.time_since_epoch() % SWITCH_PERIOD;
+            return phase < SWITCH_PERIOD * m_intensity / UINT8_MAX;
+        }
+
+        [[nodiscard]] uint8_t intensity() const {
+            return m_intensity;
+        }
+    };
+
+    /**
+     * Time from a rumble command arriving to the motor being driven
+     */
+    struct RumbleLatency {
+        uint32_t commands = 0;
+        std::chrono::microseconds total{};
+        std::chrono::microseconds worst{};
+
+        void record(std::chrono::steady_clock::duration latency) {
+            const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(latency);
+            ++commands;
+            total += micros;
+            worst = std::max(worst, micros);
+        }
+    };
+}
@@ -10,275 +10,1503 @@
 #include <deque>
 #include <set>
 #include <array>
-#include <thread>
-#include <unordered_map>
+#include <atomic>
 #include <cmath>
+#include <thread>
+#include <optional>
+#include <span>
 
 #include "net/endpoint.h"
-#include "net/udp_socket.h"
+#include "net/server_socket.h"
+#include "net/socket_profile.h"
+#include "net/multicast.h"
 
 #include "dsu/DsuPacket.hpp"
+#include "dsu/ResponseCache.hpp"
+#include "dsu/InputPredictor.hpp"
+#include "dsu/Rumble.hpp"
+#include "dsu/MotionCalibration.hpp"
 #include "utils/reader.hpp"
 #include "utils/logger.h"
-#include "net/client.hpp"
-
-std::unordered_map<sockets::endpoint, net::client> clients;
-
-std::unordered_map<VPADButtons, DSU::ButtonGroup1> button_group_1;
-std::unordered_map<VPADButtons, DSU::ButtonGroup2> button_group_2;
-
-bool running = false;
-
-void start_server();
-void map_buttons();
-void server_loop(sockets::udp_socket&);
-
-int main(){
+#include "net/client_registry.hpp"
+#include "net/send_queue.hpp"
+#include "net/request_coalescer.hpp"
+#include "net/duty_cycle.hpp"
+#include "net/pipeline.hpp"
+#include "net/dispatch.hpp"
+#include "net/fanout.hpp"
+#include "net/shm_publisher.h"
+#include "utils/alloc_tracker.h"
+#include "utils/pinned_thread.h"
+#include "utils/spsc_ring.hpp"
+#include "utils/tick_scheduler.h"
+#include "utils/trace.hpp"
+
+// The server runs as four stages, each on its own thread, handing preallocated descriptors along single producer queues:
+// receive reads the socket, decode parses requests and owns the client registry and cached replies,
+// sampling reads the GamePad and encodes data, transmit owns the send queues and writes the socket.
+#ifndef DSU_MAX_CLIENTS
+#define DSU_MAX_CLIENTS 16
+#endif
+constexpr size_t MAX_CLIENTS = DSU_MAX_CLIENTS;
+net::client_registry<MAX_CLIENTS> registry;
+// Registry reader index of the sampling stage, which publishes controller data
+constexpr size_t PUBLISHER = 0;
+
+using outbound_ring = utils::spsc_ring<net::outbound_datagram, 64>;
+// receive -> decode
+utils::spsc_ring<net::inbound_datagram, 64> received;
+// decode -> transmit, replies and client resets
+outbound_ring control_out;
+// sampling -> transmit, controller data
+outbound_ring data_out;
+// sampling -> decode, so info replies follow the GamePad's state
+utils::spsc_ring<DSU::Packets::Outgoing::ControllerResponseHead, 8> slot_changes;
+
+struct {
+    net::stage_stats receive;
+    net::stage_stats decode;
+    net::stage_stats sampling;
+    net::stage_stats transmit;
+} stage_stats;
+
+// Owned by the sampling stage, a sequence restarts when its client table entry is handed to a new client
+struct data_sequence {
+    uint16_t generation = 0;
+    uint32_t packet_number = 0;
+    // Motion samples already sent to a client that takes them batched, counted like motion_sample_count
+    uint64_t batched_through = 0;
+};
+std::array<data_sequence, MAX_CLIENTS> data_sequences{};
+// Owned by the sampling stage, the snapshot position publishing starts from, where the last sample ran out of descriptors
+size_t publish_start = 0;
+// Owned by the transmit stage
+net::send_queues<MAX_CLIENTS> send_queues;
+#ifdef DSU_FANOUT_WORKERS
+#ifndef __linux__
+#error "DSU_FANOUT_WORKERS is only supported on Linux hosts"
+#endif
+// Host deployments with many subscribers encode and send controller data on several lanes instead of going through transmit.
+// The sampling stage is lane 0 and starts a round per sample, the others each run on a thread of their own.
+constexpr size_t FANOUT_LANES = DSU_FANOUT_WORKERS;
+// Datagrams a lane gathers before handing them to sendmmsg
+constexpr size_t FANOUT_BATCH = 32;
+// Each lane sends from its own socket bound to the server port, so lanes never share a socket and clients see the usual source port
+struct fanout_lane {
+    std::optional<sockets::udp_socket> socket;
+    std::array<std::array<uint8_t, net::MAX_DATAGRAM>, FANOUT_BATCH> buffers{};
+    std::array<sockets::endpoint, FANOUT_BATCH> endpoints{};
+    std::array<sockets::outgoing_datagram, FANOUT_BATCH> batch{};
+    size_t pending = 0;
+    // Written by the lane, read by the supervisor
+    std::atomic<uint32_t> sent{0};
+    std::atomic<uint32_t> dropped{0};
+};
+std::array<fanout_lane, FANOUT_LANES> fanout_lanes;
+net::fanout_rounds<FANOUT_LANES> fanout;
+// What the current round publishes, set by the sampling stage before starting it
+struct fanout_work {
+    const net::registry_snapshot<MAX_CLIENTS>* snapshot = nullptr;
+    uint8_t slot = 0;
+    std::chrono::steady_clock::time_point now{};
+
+    void item(size_t lane, size_t index);
+    void done(size_t lane);
+} fanout_round;
+#endif
+// Owned by the decode stage
+net::request_coalescer<MAX_CLIENTS> coalescer;
+DSU::ResponseCache responses;
+// Owned by the decode stage, rumble is applied as soon as a command is decoded rather than waiting for the next sample
+std::array<DSU::RumbleSlot, net::MAX_SLOTS> rumble_slots{};
+// Whether each Wii Remote motor is switched on right now, slot 0 is the GamePad and isn't switched
+std::array<bool, net::MAX_SLOTS> motor_switched{};
+DSU::RumbleLatency rumble_latency;
+// Datagrams whose message type has no handler
+uint32_t unknown_requests = 0;
+// Datagrams shorter than a header, or with the wrong magic, protocol version or CRC
+uint32_t invalid_requests = 0;
+// Datagrams decoded per step, so slot changes and registry updates aren't held up by a flood
+constexpr size_t MAX_DRAIN = 32;
+#ifndef DSU_SAMPLE_RATE
+#define DSU_SAMPLE_RATE 250
+#endif
+#ifndef DSU_TICK_SPIN_US
+#define DSU_TICK_SPIN_US 0
+#endif
+// While streaming the sampling stage ticks at a fixed rate instead of polling the GamePad
+constexpr auto SAMPLE_PERIOD = std::chrono::nanoseconds(1000000000 / DSU_SAMPLE_RATE);
+constexpr auto SAMPLE_SPIN = std::chrono::microseconds(DSU_TICK_SPIN_US);
+// Longest the receive stage blocks on the socket, bounds how late shutdown is noticed
+constexpr auto RECEIVE_WAIT = std::chrono::milliseconds(100);
+// When any client last sent something, as steady_clock ticks. Clients are live for a subscription timeout after that
+std::atomic<std::chrono::steady_clock::rep> last_request{0};
+
+constexpr std::array<std::pair<VPADButtons, DSU::ButtonGroup1>, 8> button_group_1{{
+    {VPAD_BUTTON_LEFT, DSU::ButtonGroup1::DPAD_LEFT},
+    {VPAD_BUTTON_RIGHT, DSU::ButtonGroup1::DPAD_RIGHT},
+    {VPAD_BUTTON_UP, DSU::ButtonGroup1::DPAD_UP},
+    {VPAD_BUTTON_DOWN, DSU::ButtonGroup1::DPAD_DOWN},
+    {VPAD_BUTTON_PLUS, DSU::ButtonGroup1::OPTIONS},
+    {VPAD_BUTTON_MINUS, DSU::ButtonGroup1::SHARE},
+    {VPAD_BUTTON_STICK_L, DSU::ButtonGroup1::L3},
+    {VPAD_BUTTON_STICK_R, DSU::ButtonGroup1::R3}
+}};
+constexpr std::array<std::pair<VPADButtons, DSU::ButtonGroup2>, 8> button_group_2{{
+    {VPAD_BUTTON_A, DSU::ButtonGroup2::A},
+    {VPAD_BUTTON_B, DSU::ButtonGroup2::B},
+    {VPAD_BUTTON_X, DSU::ButtonGroup2::X},
+    {VPAD_BUTTON_Y, DSU::ButtonGroup2::Y},
+    {VPAD_BUTTON_ZL, DSU::ButtonGroup2::L2},
+    {VPAD_BUTTON_ZR, DSU::ButtonGroup2::R2},
+    {VPAD_BUTTON_L, DSU::ButtonGroup2::L1},
+    {VPAD_BUTTON_R, DSU::ButtonGroup2::R1}
+}};
+
+net::multicast_config multicast{};
+net::multicast_lease multicast_lease;
+uint32_t multicast_packet_number = 0;
+
+// The motion fields hold calibrated values: acceleration in g and angular velocity in degrees per second, gyro x, y and z being pitch, yaw and roll
+VPADStatus gamepad_status{};
+// Owned by the sampling stage, applied to every sample as it's read
+DSU::MotionCalibration calibration;
+DSU::GyroBiasEstimator bias_estimator;
+// sampling -> supervisor, newly measured gyro biases to store
+utils::spsc_ring<DSU::Vector3, 4> bias_updates;
+// sampling -> supervisor, set when the diagnostics combination is pressed
+std::atomic<bool> dump_requested{false};
+// The newest motion samples, owned by the sampling stage, so clients taking batches get every one of them
+std::array<DSU::Packets::Outgoing::MotionSample, DSU::Packets::Outgoing::MotionSamples::MAX_SAMPLES> motion_history{};
+uint64_t motion_sample_count = 0;
+#ifdef DSU_PREDICTION
+// How far ahead of the sample clients are sent input, from the client's own measurement of packet age when it acts on it
+constexpr auto PREDICTION_LEAD = std::min<std::chrono::microseconds>(std::chrono::microseconds(DSU_PREDICTION_LEAD_US), DSU::InputPredictor::MAX_HORIZON);
+static_assert(PREDICTION_LEAD > std::chrono::microseconds::zero(), "DSU_PREDICTION needs a DSU_PREDICTION_LEAD_US above zero");
+// Owned by the sampling stage like gamepad_status
+DSU::InputPredictor predictor;
+// gamepad_status extrapolated by PREDICTION_LEAD, predicted once per sample and sent to every client
+VPADStatus predicted_status{};
+#endif
+#ifdef DSU_SHARED_MEMORY
+// Written by the sampling stage, processes on the same machine read every sample from it without going through the network stack
+std::optional<net::shm::publisher> shared_memory;
+uint32_t shared_packet_number = 0;
+#endif
+
+// Pressing this combination dumps the capture and trace rings, the buttons still reach clients as usual
+constexpr uint32_t DIAGNOSTICS_COMBO = VPAD_BUTTON_L | VPAD_BUTTON_R | VPAD_BUTTON_MINUS;
+#ifdef __WIIU__
+constexpr const char* CAPTURE_PATH = "fs:/vol/external01/dsu_capture.pcap";
+constexpr const char* TRACE_PATH = "fs:/vol/external01/dsu_trace.json";
+constexpr const char* CALIBRATION_PATH = "fs:/vol/external01/dsu_calibration.txt";
+constexpr const char* THREADS_PATH = "fs:/vol/external01/dsu_threads.txt";
+#else
+constexpr const char* CAPTURE_PATH = "dsu_capture.pcap";
+constexpr const char* TRACE_PATH = "dsu_trace.json";
+constexpr const char* CALIBRATION_PATH = "dsu_calibration.txt";
+constexpr const char* THREADS_PATH = "dsu_threads.txt";
+#endif
+#ifdef DSU_CAPTURE
+sockets::capture_ring capture;
+#endif
+
+std::atomic<bool> running{false};
+
+#ifndef DSU_SERVER_PORT
+#define DSU_SERVER_PORT 26760
+#endif
+// 0 lets the system pick a free port, for tests
+constexpr uint16_t SERVER_PORT = DSU_SERVER_PORT;
+// The port the server socket is bound to, 0 until it is
+std::atomic<uint16_t> bound_port{0};
+
+// What the decode and sampling stages keep between steps
+struct decode_state {
+    std::chrono::steady_clock::time_point next_report{};
+    uint32_t reported_coalesced = 0;
+    uint32_t reported_rumble = 0;
+    uint32_t reported_unknown = 0;
+    uint32_t reported_invalid = 0;
+};
+
+// What a message handler is given, the header has been parsed and the sender registered as a client
+struct request_context {
+    const DSU::Packets::Header& header;
+    // Positioned at the start of the body
+    utils::reader& reader;
+    // Of the whole datagram
+    size_t length;
+    size_t client;
+    const sockets::endpoint& sender_ep;
+    std::chrono::steady_clock::time_point now;
+};
+
+struct sampling_state {
+    net::duty_cycle duty;
+    // The slot 0 description decode was last told about
+    DSU::Packets::Outgoing::ControllerResponseHead reported_head{};
+    // A stale sample is no use to anyone, so ticks missed while busy are dropped rather than made up
+    utils::tick_scheduler ticks{SAMPLE_PERIOD, utils::overrun_policy::SKIP, SAMPLE_SPIN};
+    std::chrono::steady_clock::time_point next_report{};
+};
+
+void start_server(const utils::thread_layout&);
+void supervise();
+bool receive_step(sockets::server_socket&);
+bool decode_step(decode_state&);
+bool sampling_step(sampling_state&);
+bool transmit_step(sockets::server_socket&);
+void transmit(sockets::server_socket&, net::outbound_datagram&);
+net::outbound_datagram* claim_outbound(outbound_ring&, net::outbound_command, net::datagram_kind, size_t, uint16_t, const sockets::endpoint&);
+bool queue_reply(size_t, const sockets::endpoint&, const net::shared_datagram&);
+void handle_request(uint8_t*, ssize_t, const sockets::endpoint&, std::chrono::steady_clock::time_point);
+void handle_version(request_context&);
+void handle_info(request_context&);
+void handle_data(request_context&);
+void handle_multicast_group(request_context&);
+void handle_motion_batch(request_context&);
+void handle_motor_info(request_context&);
+void handle_rumble(request_context&);
+bool sample_gamepad();
+void calibrate(VPADStatus&);
+void load_calibration();
+void save_calibration(const DSU::Vector3&);
+DSU::Packets::Outgoing::ControllerResponseHead describe_slot(uint8_t);
+void write_controller_data(DSU::Packets::Outgoing::OutgoingPacket&, const VPADStatus&, uint32_t, DSU::Packets::Outgoing::MotionSamples* = nullptr);
+void record_motion(const VPADStatus&);
+void publish_multicast();
+void publish_slot(uint8_t, std::chrono::steady_clock::time_point);
+#ifdef DSU_SHARED_MEMORY
+void publish_shared();
+#endif
+bool wants_sample(const net::subscriber&, uint8_t, std::chrono::steady_clock::time_point);
+uint16_t encode_sample(const net::subscriber&, std::span<uint8_t, net::MAX_DATAGRAM>);
+#ifdef DSU_FANOUT_WORKERS
+void flush_lane(fanout_lane&);
+void report_fanout();
+#endif
+#ifdef DSU_PREDICTION
+DSU::InputSample to_input_sample(const VPADStatus&, std::chrono::steady_clock::time_point);
+void apply_prediction(VPADStatus&, const DSU::InputSample&);
+#endif
+uint8_t target_slots(const DSU::Packets::Incoming::ControllerData&);
+uint8_t motor_count(uint8_t);
+void drive_motor(uint8_t, std::chrono::steady_clock::time_point);
+void drive_motors(std::chrono::steady_clock::time_point);
+void report_ticks(const utils::tick_stats&);
+void release_client(size_t);
+void dump_diagnostics();
+net::activity current_activity(std::chrono::steady_clock::time_point);
+
+constexpr net::dispatch_table<request_context> message_handlers{std::array{
+    net::message_handler<request_context>{DSU::DSUMessageType::PROTOCOL_VERSION, handle_version},
+    net::message_handler<request_context>{DSU::DSUMessageType::CONTROLLER_INFO, handle_info},
+    net::message_handler<request_context>{DSU::DSUMessageType::CONTROLLER_DATA, handle_data},
+    net::message_handler<request_context>{DSU::DSUMessageType::MULTICAST_GROUP, handle_multicast_group},
+    net::message_handler<request_context>{DSU::DSUMessageType::MOTION_BATCH, handle_motion_batch},
+    net::message_handler<request_context>{DSU::DSUMessageType::PORT_MOTOR_INFO, handle_motor_info},
+    net::message_handler<request_context>{DSU::DSUMessageType::RUMBLE, handle_rumble}
+}};
+
+// Tests link the server with their own main and start it under another name
+#ifndef DSU_ENTRY_POINT
+#define DSU_ENTRY_POINT main
+#endif
+
+int DSU_ENTRY_POINT(){
     WHBProcInit();
     WHBLogUdpInit();
     WHBLogPrint("Hello world");
-    map_buttons();
-    start_server();
+    WPADInit();
+
+    utils::thread_layout layout{};
+    const auto loaded = layout.load(THREADS_PATH);
+    const auto moved = layout.separate_background();
+    utils::log::start(layout.logging);
+    if (loaded > 0)
+        INFO_FUNCTION_LINE("Placed %d threads as configured in %s", static_cast<int>(loaded), THREADS_PATH);
+    if (moved)
+        INFO_FUNCTION_LINE("Moved logging to core %d, away from the pipeline stages", layout.logging.core);
+
+#ifdef DSU_MULTICAST_GROUP
+    multicast.enabled = true;
+    multicast.group = sockets::endpoint{DSU_MULTICAST_GROUP, DSU_MULTICAST_PORT};
+#endif
+
+    start_server(layout);
     return EXIT_SUCCESS;
 }
 
 
-void start_server(){
-    std::thread loop_thread;
+void start_server(const utils::thread_layout& layout){
+    std::array<utils::pinned_thread, 4> stages;
+#ifdef DSU_FANOUT_WORKERS
+    std::array<utils::pinned_thread, FANOUT_LANES - 1> lanes;
+#endif
 
-    sockets::udp_socket serverSocket;
-    DEBUG_FUNCTION_LINE("Initialized socket")
+    sockets::server_socket serverSocket;
+    DEBUG_FUNCTION_LINE("Initialized socket");
     try {
-        sockets::endpoint localEp{INADDR_ANY, 26760};
+        sockets::endpoint localEp{INADDR_ANY, SERVER_PORT};
 
-        serverSocket.set_option<int>(sockets::option_name::REUSE_ADDRESS, 1);
+        serverSocket.set_option<sockets::options::reuse_address>(1);
+#ifdef DSU_FANOUT_WORKERS
+        serverSocket.set_option<sockets::options::reuse_port>(1);
+#endif
         serverSocket.bind(localEp);
+        localEp = serverSocket.local_endpoint();
+        bound_port.store(localEp.port(), std::memory_order_release);
+#ifdef DSU_CAPTURE
+        capture.set_local(localEp);
+        serverSocket.set_capture(&capture);
+#endif
+
+        const auto applied = sockets::apply_profile(serverSocket, sockets::low_latency_profile);
+        INFO_FUNCTION_LINE("Socket profile: {TOS: %d, Send buffer: %d, Receive buffer: %d}",
+                            applied.type_of_service, applied.send_buffer_size, applied.receive_buffer_size);
+
+        net::apply_multicast(serverSocket, multicast);
+        if (multicast.enabled)
+            INFO_FUNCTION_LINE("Publishing to multicast group %s:%u", utils::log::ipv4{multicast.group.address_value()}, multicast.group.port());
+#ifdef DSU_SHARED_MEMORY
+        // Optional, the UDP protocol works the same without it
+        try {
+            shared_memory.emplace();
+            INFO_FUNCTION_LINE("Publishing to shared memory object %s", net::shm::DEFAULT_NAME);
+        }
+        catch (const utils::errno_error& error){
+            WARN_FUNCTION_LINE("Not publishing to shared memory: %s", error.what());
+        }
+#endif
+#ifdef DSU_FANOUT_WORKERS
+        // The lane sockets join the server socket's port group, requests still all arrive at the server socket
+        for (auto& lane : fanout_lanes){
+            auto& socket = lane.socket.emplace();
+            socket.set_option<sockets::options::reuse_port>(1);
+            socket.bind(localEp);
+            sockets::apply_profile(socket, sockets::low_latency_profile);
+#ifdef DSU_CAPTURE
+            socket.set_capture(&capture);
+#endif
+        }
+        net::steer_to_first(serverSocket);
+#endif
+
+        // Set up before any stage runs, from then on each stage only touches what it owns
+        load_calibration();
+        const auto head = describe_slot(0);
+        registry.set_slot_mac(0, head.mac_address);
+        responses.update_slot(head);
+        const auto now = std::chrono::steady_clock::now();
 
         running = true;
-        loop_thread = std::thread(server_loop, std::ref(serverSocket));
-        DEBUG_FUNCTION_LINE("Started server with address %s:%u and id %u", localEp.address(), localEp.port(), DSU::server_id)
+#ifdef DSU_FANOUT_WORKERS
+        // Started first, the sampling stage waits for every lane at the end of each round
+        for (size_t lane = 1; lane < FANOUT_LANES; ++lane){
+            lanes[lane - 1] = utils::pinned_thread({-1, utils::thread_priority::LATENCY_CRITICAL, "dsu_fanout"}, [lane] {
+                uint32_t seen = 0;
+                while (fanout.work(lane, seen, fanout_round)) {}
+            });
+        }
+        INFO_FUNCTION_LINE("Fanning out controller data on %u lanes", FANOUT_LANES);
+#endif
+        stages[0] = net::start_stage(layout.receive, running, stage_stats.receive, [&serverSocket] { return receive_step(serverSocket); });
+        stages[1] = net::start_stage(layout.decode, running, stage_stats.decode, [state = decode_state{now}]() mutable { return decode_step(state); });
+        stages[2] = net::start_stage(layout.sampling, running, stage_stats.sampling, [state = sampling_state{net::duty_cycle{now}, head}]() mutable {
+            return sampling_step(state);
+        });
+        stages[3] = net::start_stage(layout.transmit, running, stage_stats.transmit, [&serverSocket] { return transmit_step(serverSocket); });
+        for (const auto& stage : stages) {
+            if (!stage.placement_applied())
+                WARN_FUNCTION_LINE("A pipeline stage is running without its requested core and priority");
+        }
+        INFO_FUNCTION_LINE("Started server with address %s:%u and id %u", utils::log::ipv4{localEp.address_value()}, localEp.port(), DSU::server_id);
+#ifdef DSU_PREDICTION
+        INFO_FUNCTION_LINE("Extrapolating input %u us ahead for every client", static_cast<uint32_t>(PREDICTION_LEAD.count()));
+#endif
 
+        supervise();
     }
     catch (const std::runtime_error& error){
-        DEBUG_FUNCTION_LINE("An error occurred: %s", error.what())
-        running  = false;
+        ERROR_FUNCTION_LINE("An error occurred: %s", error.what());
     }
     catch (const std::invalid_argument& error){
-        DEBUG_FUNCTION_LINE("Invalid argument: %s", error.what())
-        running  = false;
+        ERROR_FUNCTION_LINE("Invalid argument: %s", error.what());
     }
-    DEBUG_FUNCTION_LINE("Waiting for server loop thread to join")
-    loop_thread.join();
-    button_group_1.clear();
-    button_group_2.clear();
+    running = false;
+    DEBUG_FUNCTION_LINE("Waiting for pipeline stages to join");
+    for (auto& stage : stages)
+        stage.join();
+#ifdef DSU_FANOUT_WORKERS
+    // Sampling has joined, so no round is running or will start
+    fanout.stop();
+    for (auto& lane : lanes)
+        lane.join();
+#endif
+    // Nothing is left to stop a motor that was running
+    for (uint8_t slot = 0; slot < net::MAX_SLOTS; ++slot){
+        rumble_slots[slot].set(0, std::chrono::steady_clock::now());
+        drive_motor(slot, std::chrono::steady_clock::now());
+    }
+    serverSocket.close();
+    INFO_FUNCTION_LINE("Socket closed");
+#ifdef DSU_SHARED_MEMORY
+    shared_memory.reset();
+#endif
+    utils::log::stop();
+    WPADShutdown();
     WHBProcShutdown();
     WHBLogUdpDeinit();
 
 
 }
 
-void server_loop(sockets::udp_socket& socket){
-    std::array<uint8_t, 1024> bufferIn{};
-    std::array<uint8_t, 1024> bufferOut{};
-
-    constexpr sockets::endpoint defaultEp{};
+/**
+ * Watches the stages from the main thread until the server is asked to stop, reporting allocations and where the pipeline backs up
+ */
+void supervise(){
+    // Everything the stages need is allocated during their first second, after that they should run off what they have
+    constexpr auto warmUp = std::chrono::seconds(1);
+    constexpr auto reportInterval = std::chrono::seconds(5);
+    constexpr auto pollInterval = std::chrono::milliseconds(100);
+    const auto start = std::chrono::steady_clock::now();
+    auto nextAllocationReport = start + warmUp;
+    bool steady = false;
+    uint32_t reportedAllocations = 0;
+    auto nextStageReport = start + reportInterval;
 
     while (running && WHBProcIsRunning()){
-        sockets::endpoint senderEp{};
-        ssize_t recvBytes = 0;
+        std::this_thread::sleep_for(pollInterval);
+        const auto now = std::chrono::steady_clock::now();
+        if (utils::alloc_tracker::enabled && now >= nextAllocationReport){
+            if (!steady){
+                utils::alloc_tracker::mark_steady_state();
+                steady = true;
+            }
+            else if (const auto allocations = utils::alloc_tracker::steady_state_allocations(); allocations != reportedAllocations){
+                WARN_FUNCTION_LINE("%u heap allocations since warm-up", allocations);
+                reportedAllocations = allocations;
+            }
+            nextAllocationReport = now + reportInterval;
+        }
+        // Kept off the sampling stage, writing to the SD card takes milliseconds
+        while (const auto* bias = bias_updates.peek()){
+            save_calibration(*bias);
+            bias_updates.pop();
+        }
+        if (dump_requested.exchange(false, std::memory_order_relaxed))
+            dump_diagnostics();
+        if (now >= nextStageReport){
+            // A stage that's never idle is the bottleneck, the queue in front of it fills up and its producer stalls
+            DEBUG_FUNCTION_LINE("Busy/idle steps: {Receive: %u/%u, Decode: %u/%u}",
+                                stage_stats.receive.busy.load(), stage_stats.receive.idle.load(),
+                                stage_stats.decode.busy.load(), stage_stats.decode.idle.load());
+            DEBUG_FUNCTION_LINE("Busy/idle steps: {Sampling: %u/%u, Transmit: %u/%u}",
+                                stage_stats.sampling.busy.load(), stage_stats.sampling.idle.load(),
+                                stage_stats.transmit.busy.load(), stage_stats.transmit.idle.load());
+            DEBUG_FUNCTION_LINE("Received queue: {Depth: %u, High water: %u, Stalls: %u}", received.depth(), received.high_water(), received.stalls());
+            DEBUG_FUNCTION_LINE("Control queue: {Depth: %u, High water: %u, Stalls: %u}", control_out.depth(), control_out.high_water(), control_out.stalls());
+            DEBUG_FUNCTION_LINE("Data queue: {Depth: %u, High water: %u, Stalls: %u}", data_out.depth(), data_out.high_water(), data_out.stalls());
+#ifdef DSU_FANOUT_WORKERS
+            report_fanout();
+#endif
+            nextStageReport = now + reportInterval;
+        }
+    }
+}
 
-        try {
-            recvBytes = socket.receive_from(bufferIn.begin(), 1024, sockets::msg_flags::DONT_WAIT, senderEp);
+/**
+ * Moves one datagram from the socket to the decode stage
+ * @return whether a datagram was received
+ */
+bool receive_step(sockets::server_socket& socket){
+    auto* const datagram = received.claim();
+    // Decode is behind, datagrams wait in the socket's buffer meanwhile
+    if (datagram == nullptr)
+        return false;
+
+    ssize_t recvBytes = 0;
+    try {
+        TRACE_SCOPE("receive");
+        if (!socket.wait_readable(RECEIVE_WAIT))
+            return false;
+        // Every DSU request fits, anything longer is truncated and rejected by decode
+        recvBytes = socket.receive_from(datagram->data.data(), datagram->data.size(), sockets::msg_flags::DONT_WAIT, datagram->remote_ep);
+    }
+    catch (const std::runtime_error& error){
+        ERROR_FUNCTION_LINE("An error occurred: %s", error.what());
+        running = false;
+    }
+    catch (const std::invalid_argument& error){
+        ERROR_FUNCTION_LINE("Invalid argument: %s", error.what());
+        running = false;
+    }
+
+    if (recvBytes <= 0)
+        return false;
+    datagram->length = static_cast<uint16_t>(recvBytes);
+    datagram->received = std::chrono::steady_clock::now();
+    received.publish();
+    return true;
+}
+
+/**
+ * Applies slot changes from sampling, handles a batch of received datagrams and publishes the registry changes they made
+ * @return whether there was anything to do
+ */
+bool decode_step(decode_state& state){
+    TRACE_SCOPE("decode");
+    bool busy = false;
+    while (const auto* head = slot_changes.peek()){
+        const auto update = responses.update_slot(*head);
+        // Tried again next step, once transmit has sent or dropped replies still pointing at the spare buffers
+        if (update == DSU::SlotUpdate::DEFERRED)
+            break;
+        if (update == DSU::SlotUpdate::CHANGED)
+            DEBUG_FUNCTION_LINE("Slot %u state changed, battery level %u", head->reporting_slot, static_cast<uint32_t>(head->battery_level));
+        slot_changes.pop();
+        busy = true;
+    }
+
+    // Everything taken in one step counts as one tick for coalescing
+    coalescer.begin_tick();
+    for (size_t drained = 0; drained < MAX_DRAIN; ++drained){
+        auto* const datagram = received.peek();
+        if (datagram == nullptr)
+            break;
+        handle_request(datagram->data.data(), datagram->length, datagram->remote_ep, datagram->received);
+        received.pop();
+        busy = true;
+    }
+
+    // The sampling stage sees this step's registrations from its next sample on
+    const auto now = std::chrono::steady_clock::now();
+    registry.expire(now);
+    registry.publish();
+    drive_motors(now);
+
+    if (now >= state.next_report){
+        const auto& coalesced = coalescer.stats();
+        if (coalesced.coalesced != state.reported_coalesced){
+            INFO_FUNCTION_LINE("Coalesced %u repeated requests, answered %u", coalesced.coalesced, coalesced.handled);
+            state.reported_coalesced = coalesced.coalesced;
         }
+        if (rumble_latency.commands != state.reported_rumble){
+            INFO_FUNCTION_LINE("Rumble latency over %u commands: average %u us, worst %u us", rumble_latency.commands,
+                               static_cast<uint32_t>(rumble_latency.total.count() / rumble_latency.commands), static_cast<uint32_t>(rumble_latency.worst.count()));
+            state.reported_rumble = rumble_latency.commands;
+        }
+        if (unknown_requests != state.reported_unknown){
+            WARN_FUNCTION_LINE("Ignored %u datagrams with an unknown message type", unknown_requests);
+            state.reported_unknown = unknown_requests;
+        }
+        if (invalid_requests != state.reported_invalid){
+            WARN_FUNCTION_LINE("Dropped %u datagrams that weren't valid DSU requests", invalid_requests);
+            state.reported_invalid = invalid_requests;
+        }
+        state.next_report = now + std::chrono::seconds(5);
+    }
+    return busy;
+}
 
-        catch (const std::runtime_error& error){
-            DEBUG_FUNCTION_LINE("An error occurred: %s", error.what())
-            running  = false;
+/**
+ * Samples the GamePad at the rate the current clients need and encodes the sample for each of them
+ * @return whether a new sample was published
+ */
+bool sampling_step(sampling_state& state){
+    auto& duty = state.duty;
+    if (duty.mode() == net::activity::STREAMING)
+        state.ticks.wait();
+    const auto now = std::chrono::steady_clock::now();
+    const auto previous = duty.mode();
+    if (duty.update(current_activity(now), now)){
+        INFO_FUNCTION_LINE("Activity %s -> %s after %u ms, entered %u times", net::to_string(previous), net::to_string(duty.mode()),
+                           static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(duty.time_in(previous, now)).count()),
+                           duty.entered(duty.mode()));
+        // The time spent in other modes isn't an overrun
+        if (duty.mode() == net::activity::STREAMING)
+            state.ticks.start();
+    }
+    if (now >= state.next_report){
+        report_ticks(state.ticks.stats());
+        state.ticks.reset_stats();
+        state.next_report = now + std::chrono::seconds(5);
+    }
+
+    if (!duty.should_sample(now)){
+        // Nothing to publish, there's no reason to come back sooner
+        std::this_thread::sleep_for(duty.wait_timeout());
+        return false;
+    }
+    if (!sample_gamepad())
+        return false;
+
+    TRACE_SCOPE("sample");
+    // Only samples where a button went down or up, logging every sample would crowd out everything else
+    if (gamepad_status.trigger != 0 || gamepad_status.release != 0)
+        DEBUG_FUNCTION_LINE("Buttons: {Held: %x, Triggered: %x, Released: %x}", gamepad_status.hold, gamepad_status.trigger, gamepad_status.release);
+    record_motion(gamepad_status);
+#ifdef DSU_PREDICTION
+    predictor.push(to_input_sample(gamepad_status, now));
+    predicted_status = gamepad_status;
+    apply_prediction(predicted_status, predictor.predict(now + PREDICTION_LEAD));
+#endif
+    const auto head = describe_slot(0);
+    if (!DSU::ResponseCache::same_state(head, state.reported_head)){
+        // Tried again with the next sample if decode is behind
+        if (auto* const change = slot_changes.claim()){
+            *change = head;
+            slot_changes.publish();
+            state.reported_head = head;
         }
+    }
+    if ((gamepad_status.hold & DIAGNOSTICS_COMBO) == DIAGNOSTICS_COMBO && (gamepad_status.trigger & DIAGNOSTICS_COMBO) != 0)
+        dump_requested.store(true, std::memory_order_relaxed);
+    if (multicast.enabled && multicast_lease.active(now))
+        publish_multicast();
+#ifdef DSU_SHARED_MEMORY
+    if (shared_memory)
+        publish_shared();
+#endif
+    publish_slot(0, now);
+    return true;
+}
 
-        catch (const std::invalid_argument& error){
-            DEBUG_FUNCTION_LINE("Invalid argument: %s", error.what())
-            running  = false;
+/**
+ * Queues whatever the other stages handed over, replies first, then sends as much as the socket takes
+ * @return whether anything was queued or sent
+ */
+bool transmit_step(sockets::server_socket& socket){
+    bool busy = false;
+    for (auto* ring : {&control_out, &data_out}){
+        // Bounded, so a producer that never stops can't keep the queues from being flushed
+        for (uint32_t taken = 0; taken < outbound_ring::capacity(); ++taken){
+            auto* const datagram = ring->peek();
+            if (datagram == nullptr)
+                break;
+            transmit(socket, *datagram);
+            ring->pop();
+            busy = true;
         }
+    }
 
-        if (recvBytes > 0){
-            DEBUG_FUNCTION_LINE("Received %d bytes", recvBytes)
+    TRACE_SCOPE("send");
+    return send_queues.flush(socket) != 0 || busy;
+}
 
-            utils::reader reader(bufferIn.begin(), recvBytes);
-            auto header = DSU::Packets::Header{};
-            header.read(reader);
-            header.swap_member_endian();
+/**
+ * Carries out one descriptor from the decode or sampling stage, dropping it if it was meant for an earlier owner of the client table entry
+ * @param socket the socket multicast data is sent from straight away
+ * @param datagram the descriptor
+ */
+void transmit(sockets::server_socket& socket, net::outbound_datagram& datagram){
+    if (datagram.command == net::outbound_command::MULTICAST){
+        try {
+            socket.send_to(datagram.data.data(), datagram.length, sockets::msg_flags::DONT_WAIT, multicast.group);
+        }
+        catch (const utils::errno_error& error){
+            WARN_FUNCTION_LINE("Failed to publish to the multicast group: %s", error.what());
+        }
+        return;
+    }
 
-            if (clients.contains(senderEp)){
-                ++clients[senderEp].packet_number;
-            }
-            else if(defaultEp != senderEp){
-                DEBUG_FUNCTION_LINE("New client connected from %s:%u", senderEp.address(), senderEp.port())
-                clients[senderEp] = net::client{.remote_ep = senderEp, .client_id = header.peer_id, .packet_number = 0};
-            }
+    // Data for the new owner can overtake the reset on the other ring, data for the old one can trail it
+    const auto order = send_queues.compare_generation(datagram.client, datagram.generation);
+    if (order < 0){
+        datagram.shared.release();
+        return;
+    }
+    if (order > 0){
+        const auto& stats = send_queues.stats(datagram.client);
+        if (stats.dropped_stale != 0 || stats.dropped_control != 0 || stats.send_errors != 0)
+            INFO_FUNCTION_LINE("Client %u evicted: %u stale samples dropped, %u replies dropped, %u send errors",
+                               datagram.client, stats.dropped_stale, stats.dropped_control, stats.send_errors);
+        send_queues.reset(datagram.client, datagram.generation);
+    }
+    if (datagram.command == net::outbound_command::RESET)
+        return;
 
-            if (clients.empty())
-                continue;
+    send_queues.set_endpoint(datagram.client, datagram.remote_ep);
+    if (!datagram.shared.data.empty()){
+        send_queues.push_control(datagram.client, datagram.shared);
+        return;
+    }
+    const auto buffer = send_queues.reserve(datagram.client, datagram.kind);
+    std::memcpy(buffer.data(), datagram.data.data(), datagram.length);
+    send_queues.commit(datagram.client, datagram.kind, datagram.length);
+}
 
-            DEBUG_FUNCTION_LINE("Packet Header: {Source: %s, Protocol Version: %u, Packet Length: %u, CRC 32: %u, ID: %u, Message Type: %u}",
-                                header.magic_string, header.protocol_version, header.packet_length, header.crc_32, header.peer_id, static_cast<uint32_t>(header.message_type))
+/**
+ * Claims a descriptor for the transmit stage, publish the ring once it has been filled in
+ * @param ring control_out from decode, data_out from sampling
+ * @param command what transmit should do with it
+ * @param kind the queue the datagram goes into
+ * @param client the client table index
+ * @param generation the registry generation of the client table entry
+ * @param remote_ep where the datagram goes
+ * @return the descriptor, nullptr if transmit is too far behind
+ */
+net::outbound_datagram* claim_outbound(outbound_ring& ring, net::outbound_command command, net::datagram_kind kind, size_t client, uint16_t generation, const sockets::endpoint& remote_ep){
+    auto* const datagram = ring.claim();
+    if (datagram == nullptr)
+        return nullptr;
+    datagram->command = command;
+    datagram->kind = kind;
+    datagram->client = static_cast<uint16_t>(client);
+    datagram->generation = generation;
+    datagram->remote_ep = remote_ep;
+    datagram->shared = {};
+    datagram->length = 0;
+    return datagram;
+}
 
-            DSU::Packets::Outgoing::OutgoingPacket packet{bufferOut.begin(), bufferOut.size()};
+/**
+ * Hands a cached reply to the transmit stage, which sends it from the cache
+ * @param reply released here if transmit is too far behind to take it
+ * @return whether transmit took it
+ */
+bool queue_reply(size_t client, const sockets::endpoint& remote_ep, const net::shared_datagram& reply){
+    auto* const datagram = claim_outbound(control_out, net::outbound_command::SEND, net::datagram_kind::CONTROL, client, registry.generation(client), remote_ep);
+    if (datagram == nullptr){
+        reply.release();
+        return false;
+    }
+    datagram->shared = reply;
+    datagram->length = static_cast<uint16_t>(reply.data.size());
+    control_out.publish();
+    return true;
+}
 
-            if (header.message_type == DSU::DSUMessageType::PROTOCOL_VERSION){
-                DEBUG_FUNCTION_LINE("Received protocol version request")
+/**
+ * Reads the body of a request with a fixed size on the wire
+ * @param context the request being handled
+ * @param request filled in, in host order
+ * @return false if the datagram is too short to hold it
+ */
+template <typename Request>
+bool read_body(request_context& context, Request& request){
+    if (context.length < context.header.size() + Request::WIRE_SIZE)
+        return false;
+    request.read(context.reader);
+    request.swap_member_endian();
+    return true;
+}
 
-                DSU::Packets::Header headerOut;
-                headerOut.message_type = DSU::DSUMessageType::PROTOCOL_VERSION;
+/**
+ * Encodes a reply to the requesting client straight into a descriptor for the transmit stage
+ * @param context the request being answered
+ * @param type the message type of the reply
+ * @param body what follows the header, swapped in place as it's written
+ * @return whether transmit took it
+ */
+template <typename... Body>
+bool reply(const request_context& context, DSU::DSUMessageType type, Body&... body){
+    auto* const datagram = claim_outbound(control_out, net::outbound_command::SEND, net::datagram_kind::CONTROL, context.client, registry.generation(context.client), context.sender_ep);
+    if (datagram == nullptr)
+        return false;
+    DSU::Packets::Header headerOut{};
+    headerOut.message_type = type;
+    DSU::Packets::Outgoing::OutgoingPacket packet{datagram->data.data(), datagram->data.size()};
+    packet.add_data(headerOut);
+    (packet.add_data(body), ...);
+    packet.set_crc32();
+    datagram->length = static_cast<uint16_t>(packet.cursor());
+    control_out.publish();
+    return true;
+}
 
-                DSU::Packets::Outgoing::VersionInfo versionInfo;
-                versionInfo.max_protocol_version = 1001;
+/**
+ * Handles one received datagram, answers are handed to the transmit stage
+ * @param data the received datagram
+ * @param length the length of the datagram
+ * @param senderEp the endpoint the datagram came from
+ * @param now the time the datagram was received
+ */
+void handle_request(uint8_t* data, ssize_t length, const sockets::endpoint& senderEp, std::chrono::steady_clock::time_point now){
+    TRACE_SCOPE("parse");
+    constexpr sockets::endpoint defaultEp{};
 
-                DEBUG_FUNCTION_LINE("Cursor at %u", packet.cursor())
+    // Receive buffers are reused, anything shorter than a header would be read from the previous datagram's bytes
+    if (length < static_cast<ssize_t>(DSU::Packets::Header::SIZE)){
+        ++invalid_requests;
+        return;
+    }
 
-                packet.add_data(headerOut);
-                DEBUG_FUNCTION_LINE("Cursor at %u", packet.cursor())
+    utils::reader reader(data, length);
+    auto header = DSU::Packets::Header{};
+    header.read(reader);
+    header.swap_member_endian();
 
-                packet.add_data(versionInfo);
-                DEBUG_FUNCTION_LINE("Cursor at %u", packet.cursor())
+    // Rejected before the sender takes up a client table entry, which may evict another client
+    if (!DSU::Packets::Incoming::valid(header, {data, static_cast<size_t>(length)})){
+        ++invalid_requests;
+        return;
+    }
+    const auto handler = message_handlers.find(header.message_type);
+    if (handler == nullptr){
+        ++unknown_requests;
+        DEBUG_FUNCTION_LINE("Ignored message type %x", static_cast<uint32_t>(header.message_type));
+        return;
+    }
 
-                packet.set_crc32();
+    auto* client = registry.find(senderEp);
+    if (client == nullptr && defaultEp != senderEp){
+        DEBUG_FUNCTION_LINE("New client connected from %s:%u", utils::log::ipv4{senderEp.address_value()}, senderEp.port());
+        const auto index = registry.insert(net::client{.remote_ep = senderEp, .client_id = header.peer_id});
+        client = &registry.clients()[index];
+        // The entry may have belonged to an evicted client
+        release_client(index);
+    }
 
-                const auto sentBytes = socket.send_to(packet.begin(), packet.cursor(), sockets::msg_flags::DONT_WAIT, senderEp);
-                DEBUG_FUNCTION_LINE("Sent %d bytes", sentBytes)
+    if (client == nullptr)
+        return;
+    client->last_seen = now;
+    last_request.store(now.time_since_epoch().count(), std::memory_order_relaxed);
 
-            }
-            else if (header.message_type == DSU::DSUMessageType::CONTROLLER_INFO){
-                DEBUG_FUNCTION_LINE("Received controller information request")
-
-                VPADStatus vpadStatus;
-                VPADReadError error;
-                VPADRead(VPADChan::VPAD_CHAN_0, &vpadStatus, 1, &error);
-
-                DSU::Packets::Header headerOut{};
-                headerOut.message_type = DSU::DSUMessageType::CONTROLLER_INFO;
-
-                DSU::Packets::Outgoing::ControllerResponseHead crh{};
-                crh.reporting_slot = 0;
-                crh.slot_state = DSU::SlotState::CONNECTED;
-                crh.device_model = DSU::DeviceModel::FULL_GYRO;
-                crh.connection_type = DSU::ConnectionType::NOT_APPLICABLE;
-                crh.mac_address = DSU::MacAddress{0};
-                crh.battery_level = static_cast<DSU::BatteryLevel>(vpadStatus.battery / 6);
-
-                DSU::Packets::Outgoing::ConnectedControllers cc;
-                cc.head = crh;
-                cc.tail = '\0';
-
-                DEBUG_FUNCTION_LINE("Cursor at %u", packet.cursor())
-                packet.add_data(headerOut);
-                DEBUG_FUNCTION_LINE("Cursor at %u", packet.cursor())
-                packet.add_data(cc);
-                DEBUG_FUNCTION_LINE("Cursor at %u", packet.cursor())
-                packet.set_crc32();
-
-                const auto sentBytes = socket.send_to(packet.begin(), packet.cursor(), sockets::msg_flags::DONT_WAIT, senderEp);
-                DEBUG_FUNCTION_LINE("Sent %d bytes", sentBytes)
-            }
-            else if (header.message_type == DSU::DSUMessageType::CONTROLLER_DATA){
-                DEBUG_FUNCTION_LINE("Received controller data request")
-
-                VPADStatus vpadStatus;
-                VPADReadError error;
-                VPADRead(VPADChan::VPAD_CHAN_0, &vpadStatus, 1, &error);
-
-                DSU::Packets::Header headerOut{};
-                headerOut.message_type = DSU::DSUMessageType::CONTROLLER_DATA;
-
-                DSU::Packets::Outgoing::ControllerResponseHead crh{};
-                crh.reporting_slot = 0;
-                crh.slot_state = DSU::SlotState::CONNECTED;
-                crh.device_model = DSU::DeviceModel::FULL_GYRO;
-                crh.connection_type = DSU::ConnectionType::NOT_APPLICABLE;
-                crh.mac_address = DSU::MacAddress{0};
-                crh.battery_level = static_cast<DSU::BatteryLevel>(vpadStatus.battery / 6);
-
-                DSU::Packets::Outgoing::ControllerData data{};
-
-                data.beginning = crh;
-                data.connected = true;
-                data.packet_number = ++clients[senderEp].packet_number;
-
-                for (auto kp : button_group_1){
-                    if (vpadStatus.hold & kp.first){
-                        data.button_mask_1 = data.button_mask_1 | kp.second;
-                    }
-                }
-                for (auto kp : button_group_2){
-                    if (vpadStatus.hold & kp.first){
-                        data.button_mask_2 = data.button_mask_2 | kp.second;
-                    }
-                }
-                DEBUG_FUNCTION_LINE("Held: %u", vpadStatus.hold);
-                DEBUG_FUNCTION_LINE("Triggered: %u", vpadStatus.trigger)
-                DEBUG_FUNCTION_LINE("Released: %u", vpadStatus.release)
-
-                data.home_button = vpadStatus.trigger & VPADButtons ::VPAD_BUTTON_HOME;
-                data.touch_button = false; // No idea what this is equivalent to
-                data.l_stick.x = (uint8_t)std::round(((vpadStatus.leftStick.x + 1) / 2) * 256);
-                data.l_stick.y = (uint8_t)std::round(((vpadStatus.leftStick.y + 1) / 2) * 256);
-                data.r_stick.x = (uint8_t)std::round(((vpadStatus.rightStick.x + 1) / 2) * 256);
-                data.r_stick.y = (uint8_t)std::round(((vpadStatus.rightStick.y + 1) / 2) * 256);
-
-                data.analog_dp.left = 255 * ((data.button_mask_1 & DSU::ButtonGroup1::DPAD_LEFT) == DSU::ButtonGroup1::DPAD_LEFT);
-                data.analog_dp.down = 255 * ((data.button_mask_1 & DSU::ButtonGroup1::DPAD_DOWN) == DSU::ButtonGroup1::DPAD_DOWN);
-
-                data.analog_dp.right = 255 * ((data.button_mask_1 & DSU::ButtonGroup1::DPAD_RIGHT) == DSU::ButtonGroup1::DPAD_RIGHT);
-                data.analog_dp.up = 255 * ((data.button_mask_1 & DSU::ButtonGroup1::DPAD_UP) == DSU::ButtonGroup1::DPAD_UP);
-
-                data.analog_face.y = 255 * ((bool)(data.button_mask_2 & DSU::ButtonGroup2::Y));
-                data.analog_face.b = 255 * ((bool)(data.button_mask_2 & DSU::ButtonGroup2::B));
-                data.analog_face.a = 255 * ((bool)(data.button_mask_2 & DSU::ButtonGroup2::A));
-                data.analog_face.x = 255 * ((bool)((data.button_mask_2 & DSU::ButtonGroup2::X)));
-
-                data.first_touch.active = 0;
-                data.second_touch.active = 0;
-
-                data.accelerometer.x = vpadStatus.accelorometer.acc.x;
-                data.accelerometer.y = vpadStatus.accelorometer.acc.y;
-                data.accelerometer.z = vpadStatus.accelorometer.acc.z;
-
-                data.gyroscope.pitch = vpadStatus.gyro.x;
-                data.gyroscope.roll = vpadStatus.gyro.z;
-                data.gyroscope.yaw = vpadStatus.gyro.y;
-
-                packet.add_data(headerOut);
-                packet.add_data(data);
-                packet.set_crc32();
-                const auto sentBytes = socket.send_to(packet.begin(), packet.cursor(), sockets::msg_flags::DONT_WAIT, senderEp);
-                DEBUG_FUNCTION_LINE("Sent %d bytes", sentBytes)
+    request_context context{header, reader, static_cast<size_t>(length), registry.clients().index_of(*client), senderEp, now};
+    handler(context);
+}
+
+void handle_version(request_context& context){
+    DEBUG_FUNCTION_LINE("Received protocol version request");
+    if (!coalescer.admit(context.client, {context.header.message_type}))
+        return;
+    queue_reply(context.client, context.sender_ep, responses.version());
+}
+
+void handle_info(request_context& context){
+    DEBUG_FUNCTION_LINE("Received controller information request");
+
+    using DSU::Packets::Incoming::ConnectedControllers;
+
+    // The only request whose length depends on its content, so it isn't read through read_body
+    ConnectedControllers request{};
+    if (context.length >= context.header.size() + sizeof(request.report_port_count)){
+        request.read(context.reader);
+        request.swap_member_endian();
+    }
+    // Never trust the count beyond the ids that actually arrived
+    const auto body = context.header.size() + sizeof(request.report_port_count);
+    const auto available = context.length > body ? static_cast<int32_t>(std::min<size_t>(context.length - body, ConnectedControllers::MAX_PORTS)) : 0;
+    const auto requested = std::clamp(std::min(request.report_port_count, available), 0, ConnectedControllers::MAX_PORTS);
+
+    // One cached datagram per requested slot, all of them go out together with the next flush
+    size_t replyCount = 0;
+    for (int32_t i = 0; i < requested; ++i){
+        const auto slot = request.port_id[i];
+        if (slot >= ConnectedControllers::MAX_PORTS)
+            continue;
+        if (!coalescer.admit(context.client, {context.header.message_type, slot}))
+            continue;
+        if (queue_reply(context.client, context.sender_ep, responses.acquire_info(slot)))
+            ++replyCount;
+    }
+    DEBUG_FUNCTION_LINE("Queued %u slot replies", replyCount);
+}
+
+void handle_data(request_context& context){
+    DEBUG_FUNCTION_LINE("Received controller data request");
+
+    DSU::Packets::Incoming::ControllerData request{};
+    if (!read_body(context, request))
+        return;
+    if (!coalescer.admit(context.client, net::request_key::registration(request)))
+        return;
+
+    // Data goes out as new samples arrive, the request only registers interest
+    registry.subscribe(context.client, request, context.now);
+}
 
+void handle_multicast_group(request_context& context){
+    DEBUG_FUNCTION_LINE("Received multicast group request");
+    if (!coalescer.admit(context.client, {context.header.message_type}))
+        return;
+
+    DSU::Packets::Outgoing::MulticastGroup group{};
+    if (multicast.enabled){
+        multicast_lease.renew(context.now);
+        const auto address = htonl(multicast.group.address_value());
+        std::memcpy(group.address.data(), &address, sizeof(address));
+        group.port = multicast.group.port();
+        group.ttl = multicast.ttl;
+        group.enabled = 1;
+    }
+    reply(context, DSU::DSUMessageType::MULTICAST_GROUP, group);
+}
+
+void handle_motion_batch(request_context& context){
+    DEBUG_FUNCTION_LINE("Received motion batch request");
+
+    using DSU::Packets::Outgoing::MotionSamples;
+
+    DSU::Packets::Incoming::MotionBatch request{};
+    if (!read_body(context, request))
+        return;
+    auto key = net::request_key::registration(request.target);
+    key.type = context.header.message_type;
+    if (!coalescer.admit(context.client, key))
+        return;
+
+    // Registers like CONTROLLER_DATA, only the format of the data changes
+    DSU::Packets::Outgoing::MotionBatchAccept accept{};
+    accept.samples = request.max_samples < 2 ? 0 : std::min(request.max_samples, MotionSamples::MAX_SAMPLES);
+    registry.subscribe(context.client, request.target, context.now);
+    registry.set_motion_batch(context.client, accept.samples);
+    reply(context, DSU::DSUMessageType::MOTION_BATCH, accept);
+}
+
+void handle_motor_info(request_context& context){
+    DEBUG_FUNCTION_LINE("Received motor information request");
+
+    DSU::Packets::Incoming::ControllerData request{};
+    if (!read_body(context, request))
+        return;
+
+    const auto slots = target_slots(request);
+    for (uint8_t slot = 0; slot < net::MAX_SLOTS; ++slot){
+        if ((slots & (1u << slot)) == 0 || !coalescer.admit(context.client, {context.header.message_type, slot}))
+            continue;
+        DSU::Packets::Outgoing::MotorInfo info{};
+        info.head = responses.head(slot);
+        info.motor_count = motor_count(slot);
+        if (!reply(context, DSU::DSUMessageType::PORT_MOTOR_INFO, info))
+            return;
+    }
+}
+
+void handle_rumble(request_context& context){
+    DSU::Packets::Incoming::Rumble request{};
+    if (!read_body(context, request))
+        return;
+    DEBUG_FUNCTION_LINE("Received rumble request for motor %u, intensity %u", request.motor_id, request.intensity);
+
+    // Never coalesced, the newest intensity is the one that counts
+    const auto slots = target_slots(request.target);
+    for (uint8_t slot = 0; slot < net::MAX_SLOTS; ++slot){
+        if ((slots & (1u << slot)) == 0 || request.motor_id >= motor_count(slot))
+            continue;
+        if (rumble_slots[slot].set(request.intensity, context.now)){
+            drive_motor(slot, context.now);
+            rumble_latency.record(std::chrono::steady_clock::now() - context.now);
+        }
+    }
+}
+
+/**
+ * Reads the newest GamePad sample into gamepad_status, which keeps the last good sample when there's nothing new
+ * @return whether a new sample was read
+ */
+bool sample_gamepad(){
+    TRACE_SCOPE("input read");
+    VPADStatus status;
+    VPADReadError error;
+    VPADRead(VPADChan::VPAD_CHAN_0, &status, 1, &error);
+    if (error != VPADReadError::VPAD_READ_SUCCESS)
+        return false;
+    calibrate(status);
+    gamepad_status = status;
+    return true;
+}
+
+/**
+ * Turns a raw sample's motion into DSU units and axes, and measures the gyro's bias whenever the GamePad lies still
+ */
+void calibrate(VPADStatus& status){
+    DSU::Vector3 accelerometer{status.accelorometer.acc.x, status.accelorometer.acc.y, status.accelorometer.acc.z};
+    DSU::Vector3 gyroscope{status.gyro.x, status.gyro.y, status.gyro.z};
+    if (const auto bias = bias_estimator.push(accelerometer, gyroscope)){
+        // Only a real change is worth a write to the SD card
+        const auto& current = calibration.gyro_bias();
+        bool changed = false;
+        for (size_t axis = 0; axis < 3; ++axis)
+            changed |= std::abs((*bias)[axis] - current[axis]) > DSU::GyroBiasEstimator::MAX_SPREAD / 4;
+        if (changed){
+            calibration.set_gyro_bias(*bias);
+            if (auto* const update = bias_updates.claim()){
+                *update = *bias;
+                bias_updates.publish();
             }
         }
+    }
+    calibration.apply(accelerometer, gyroscope);
+    status.accelorometer.acc = {accelerometer[0], accelerometer[1], accelerometer[2]};
+    status.gyro = {gyroscope[0], gyroscope[1], gyroscope[2]};
+}
 
+/**
+ * Reads the stored calibration, a missing file leaves the defaults: no bias and the GamePad held as is.
+ * The file is text, a "gyro_bias x y z" line in raw units and an optional "mounting" line of 9 numbers, a row major rotation.
+ */
+void load_calibration(){
+    auto* const file = std::fopen(CALIBRATION_PATH, "r");
+    if (file == nullptr)
+        return;
+    DSU::Vector3 bias{};
+    if (std::fscanf(file, " gyro_bias %f %f %f", &bias[0], &bias[1], &bias[2]) == 3)
+        calibration.set_gyro_bias(bias);
+    DSU::Matrix3 mounting{};
+    if (std::fscanf(file, " mounting %f %f %f %f %f %f %f %f %f", &mounting[0], &mounting[1], &mounting[2],
+                    &mounting[3], &mounting[4], &mounting[5], &mounting[6], &mounting[7], &mounting[8]) == 9)
+        calibration.set_mounting(mounting);
+    std::fclose(file);
+    const auto& stored = calibration.gyro_bias();
+    INFO_FUNCTION_LINE("Loaded gyro bias %f %f %f from %s", stored[0], stored[1], stored[2], CALIBRATION_PATH);
+}
+
+/**
+ * @param bias the newly measured gyro bias, stored alongside the mounting, which only changes at startup
+ */
+void save_calibration(const DSU::Vector3& bias){
+    INFO_FUNCTION_LINE("Measured gyro bias %f %f %f at rest", bias[0], bias[1], bias[2]);
+    auto* const file = std::fopen(CALIBRATION_PATH, "w");
+    if (file == nullptr){
+        ERROR_FUNCTION_LINE("Failed to store calibration in %s: %d", CALIBRATION_PATH, errno);
+        return;
     }
-    DEBUG_FUNCTION_LINE("Socket closed")
-    running = false;
-    socket.close();
-}
-
-void map_buttons(){
-    button_group_2[VPAD_BUTTON_A] = DSU::ButtonGroup2::A;
-    button_group_2[VPAD_BUTTON_B] = DSU::ButtonGroup2::B;
-    button_group_2[VPAD_BUTTON_X] = DSU::ButtonGroup2::X;
-    button_group_2[VPAD_BUTTON_Y] = DSU::ButtonGroup2::Y;
-    button_group_1[VPAD_BUTTON_LEFT] = DSU::ButtonGroup1::DPAD_LEFT;
-    button_group_1[VPAD_BUTTON_RIGHT] = DSU::ButtonGroup1::DPAD_RIGHT;
-    button_group_1[VPAD_BUTTON_UP] = DSU::ButtonGroup1::DPAD_UP;
-    button_group_1[VPAD_BUTTON_DOWN] = DSU::ButtonGroup1::DPAD_DOWN;
-
-    button_group_2[VPAD_BUTTON_ZL] = DSU::ButtonGroup2::L2;
-    button_group_2[VPAD_BUTTON_ZR] = DSU::ButtonGroup2::R2;
-    button_group_2[VPAD_BUTTON_L] = DSU::ButtonGroup2::L1;
-    button_group_2[VPAD_BUTTON_R] = DSU::ButtonGroup2::R1;
-
-    button_group_1[VPAD_BUTTON_PLUS] = DSU::ButtonGroup1::OPTIONS;
-    button_group_1[VPAD_BUTTON_MINUS] = DSU::ButtonGroup1::SHARE;
-    button_group_1[VPAD_BUTTON_STICK_L] = DSU::ButtonGroup1::L3;
-    button_group_1[VPAD_BUTTON_STICK_R] = DSU::ButtonGroup1::R3;
-}
\ No newline at end of file
+    const auto& mounting = calibration.mounting();
+    std::fprintf(file, "gyro_bias %f %f %f\n", bias[0], bias[1], bias[2]);
+    std::fprintf(file, "mounting %f %f %f %f %f %f %f %f %f\n", mounting[0], mounting[1], mounting[2],
+                 mounting[3], mounting[4], mounting[5], mounting[6], mounting[7], mounting[8]);
+    std::fclose(file);
+}
+
+/**
+ * Slot 0 is the GamePad, the remaining slots are reported as disconnected
+ * @param slot the slot to describe
+ * @return the head shared by CONTROLLER_INFO and CONTROLLER_DATA replies
+ */
+DSU::Packets::Outgoing::ControllerResponseHead describe_slot(uint8_t slot){
+    DSU::Packets::Outgoing::ControllerResponseHead crh{};
+    crh.reporting_slot = slot;
+    if (slot != 0){
+        crh.slot_state = DSU::SlotState::DISCONNECTED;
+        return crh;
+    }
+    crh.slot_state = DSU::SlotState::CONNECTED;
+    crh.device_model = DSU::DeviceModel::FULL_GYRO;
+    crh.connection_type = DSU::ConnectionType::NOT_APPLICABLE;
+    crh.mac_address = DSU::MacAddress{0};
+    crh.battery_level = static_cast<DSU::BatteryLevel>(gamepad_status.battery / 6);
+    return crh;
+}
+
+/**
+ * Writes a complete CONTROLLER_DATA datagram for slot 0, or a MOTION_BATCH_DATA datagram when given motion samples
+ * @param packet the packet to write to, expected to be empty
+ * @param status the GamePad sample to encode
+ * @param packetNumber the packet number for the receiver of this datagram
+ * @param motion the samples to append after the state, swapped in place as it's written
+ */
+void write_controller_data(DSU::Packets::Outgoing::OutgoingPacket& packet, const VPADStatus& status, uint32_t packetNumber, DSU::Packets::Outgoing::MotionSamples* motion){
+    DSU::Packets::Header headerOut{};
+    headerOut.message_type = motion == nullptr ? DSU::DSUMessageType::CONTROLLER_DATA : DSU::DSUMessageType::MOTION_BATCH_DATA;
+
+    DSU::Packets::Outgoing::ControllerData data{};
+
+    data.beginning = describe_slot(0);
+    data.connected = true;
+    data.packet_number = packetNumber;
+
+    for (auto kp : button_group_1){
+        if (status.hold & kp.first){
+            data.button_mask_1 = data.button_mask_1 | kp.second;
+        }
+    }
+    for (auto kp : button_group_2){
+        if (status.hold & kp.first){
+            data.button_mask_2 = data.button_mask_2 | kp.second;
+        }
+    }
+
+    data.home_button = status.trigger & VPADButtons ::VPAD_BUTTON_HOME;
+    data.touch_button = false; // No idea what this is equivalent to
+    data.l_stick.x = (uint8_t)std::round(((status.leftStick.x + 1) / 2) * 256);
+    data.l_stick.y = (uint8_t)std::round(((status.leftStick.y + 1) / 2) * 256);
+    data.r_stick.x = (uint8_t)std::round(((status.rightStick.x + 1) / 2) * 256);
+    data.r_stick.y = (uint8_t)std::round(((status.rightStick.y + 1) / 2) * 256);
+
+    data.analog_dp.left = 255 * ((data.button_mask_1 & DSU::ButtonGroup1::DPAD_LEFT) == DSU::ButtonGroup1::DPAD_LEFT);
+    data.analog_dp.down = 255 * ((data.button_mask_1 & DSU::ButtonGroup1::DPAD_DOWN) == DSU::ButtonGroup1::DPAD_DOWN);
+
+    data.analog_dp.right = 255 * ((data.button_mask_1 & DSU::ButtonGroup1::DPAD_RIGHT) == DSU::ButtonGroup1::DPAD_RIGHT);
+    data.analog_dp.up = 255 * ((data.button_mask_1 & DSU::ButtonGroup1::DPAD_UP) == DSU::ButtonGroup1::DPAD_UP);
+
+    data.analog_face.y = 255 * ((bool)(data.button_mask_2 & DSU::ButtonGroup2::Y));
+    data.analog_face.b = 255 * ((bool)(data.button_mask_2 & DSU::ButtonGroup2::B));
+    data.analog_face.a = 255 * ((bool)(data.button_mask_2 & DSU::ButtonGroup2::A));
+    data.analog_face.x = 255 * ((bool)((data.button_mask_2 & DSU::ButtonGroup2::X)));
+
+    data.first_touch.active = 0;
+    data.second_touch.active = 0;
+
+    data.accelerometer.x = status.accelorometer.acc.x;
+    data.accelerometer.y = status.accelorometer.acc.y;
+    data.accelerometer.z = status.accelorometer.acc.z;
+
+    data.gyroscope.pitch = status.gyro.x;
+    data.gyroscope.roll = status.gyro.z;
+    data.gyroscope.yaw = status.gyro.y;
+
+    packet.add_data(headerOut);
+    packet.add_data(data);
+    if (motion != nullptr)
+        packet.add_data(*motion);
+    packet.set_crc32();
+}
+
+/**
+ * Keeps the motion part of a new GamePad sample for clients that take it batched
+ */
+void record_motion(const VPADStatus& status){
+    auto& sample = motion_history[motion_sample_count % motion_history.size()];
+    sample.timestamp_usec = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    sample.accelerometer.x = status.accelorometer.acc.x;
+    sample.accelerometer.y = status.accelorometer.acc.y;
+    sample.accelerometer.z = status.accelorometer.acc.z;
+    sample.gyroscope.pitch = status.gyro.x;
+    sample.gyroscope.yaw = status.gyro.y;
+    sample.gyroscope.roll = status.gyro.z;
+    ++motion_sample_count;
+}
+
+/**
+ * Hands the newest sample to transmit for the multicast group, once per sample no matter how many hosts have joined
+ */
+void publish_multicast(){
+    auto* const datagram = claim_outbound(data_out, net::outbound_command::MULTICAST, net::datagram_kind::DATA, 0, 0, multicast.group);
+    if (datagram == nullptr)
+        return;
+    DSU::Packets::Outgoing::OutgoingPacket packet{datagram->data.data(), datagram->data.size()};
+    write_controller_data(packet, gamepad_status, ++multicast_packet_number);
+    datagram->length = static_cast<uint16_t>(packet.cursor());
+    data_out.publish();
+}
+
+#ifdef DSU_SHARED_MEMORY
+/**
+ * Encodes the newest sample straight into shared memory and wakes any reader sleeping on it, once per sample like multicast
+ */
+void publish_shared(){
+    TRACE_SCOPE("shared memory");
+    const auto& motion = motion_history[(motion_sample_count - 1) % motion_history.size()];
+    shared_memory->publish_sample({motion.timestamp_usec,
+                                   {motion.accelerometer.x, motion.accelerometer.y, motion.accelerometer.z},
+                                   {motion.gyroscope.pitch, motion.gyroscope.yaw, motion.gyroscope.roll}});
+
+    const auto buffer = shared_memory->begin_snapshot(0);
+    DSU::Packets::Outgoing::OutgoingPacket packet{buffer.data(), buffer.size()};
+    write_controller_data(packet, gamepad_status, ++shared_packet_number);
+    shared_memory->commit_snapshot(0, static_cast<uint16_t>(packet.cursor()));
+    shared_memory->ring();
+}
+#endif
+
+/**
+ * Hands the newest sample of a slot to transmit for every client registered for it, which replaces a sample still waiting to be sent
+ * @param slot the slot that has a new sample
+ * @param now the current time, registrations that lapsed since the last registry update are skipped
+ */
+void publish_slot(uint8_t slot, std::chrono::steady_clock::time_point now){
+    TRACE_SCOPE("fan-out");
+    const auto snapshot = registry.read(PUBLISHER);
+#ifdef DSU_FANOUT_WORKERS
+    // Every lane works from the snapshot pinned here, the round is over before the pin is released
+    fanout_round.snapshot = &*snapshot;
+    fanout_round.slot = slot;
+    fanout_round.now = now;
+    fanout.run(snapshot->count, fanout_round);
+#else
+    const auto total = snapshot->count;
+    for (size_t i = 0; i < total; ++i){
+        const auto& subscriber = snapshot->entries[(publish_start + i) % total];
+        if (!wants_sample(subscriber, slot, now))
+            continue;
+        // Transmit is behind, the rest get the next sample instead and go first then
+        auto* const datagram = claim_outbound(data_out, net::outbound_command::SEND, net::datagram_kind::DATA, subscriber.client, subscriber.generation, subscriber.remote_ep);
+        if (datagram == nullptr){
+            publish_start = (publish_start + i) % total;
+            break;
+        }
+        datagram->length = encode_sample(subscriber, datagram->data);
+        data_out.publish();
+    }
+#endif
+}
+
+/**
+ * Restarts the packet numbers of a client table entry that changed hands, the entry's sequence is only touched by whoever encodes for it
+ * @return whether the subscriber gets a datagram for this sample of the slot
+ */
+bool wants_sample(const net::subscriber& subscriber, uint8_t slot, std::chrono::steady_clock::time_point now){
+    if (!subscriber.subscribed(slot, now))
+        return false;
+    auto& sequence = data_sequences[subscriber.client];
+    if (sequence.generation != subscriber.generation)
+        sequence = data_sequence{subscriber.generation, 0, motion_sample_count};
+    // A batching client waits until enough samples have gathered to fill its datagram
+    return subscriber.motion_batch == 0 || motion_sample_count - sequence.batched_through >= subscriber.motion_batch;
+}
+
+/**
+ * Encodes the newest sample for one subscriber
+ * @param subscriber a subscriber wants_sample accepted
+ * @param buffer the datagram to write
+ * @return the length of the datagram
+ */
+uint16_t encode_sample(const net::subscriber& subscriber, std::span<uint8_t, net::MAX_DATAGRAM> buffer){
+    TRACE_SCOPE_ARG("encode", subscriber.client);
+    auto& sequence = data_sequences[subscriber.client];
+    DSU::Packets::Outgoing::MotionSamples motion{};
+    if (subscriber.motion_batch != 0){
+        // Anything older than the history was lost to a slow transmit stage
+        motion.count = static_cast<uint8_t>(std::min<uint64_t>(motion_sample_count - sequence.batched_through, motion_history.size()));
+        for (uint8_t i = 0; i < motion.count; ++i)
+            motion.samples[i] = motion_history[(motion_sample_count - motion.count + i) % motion_history.size()];
+        sequence.batched_through = motion_sample_count;
+    }
+    DSU::Packets::Outgoing::OutgoingPacket packet{buffer.data(), buffer.size()};
+#ifdef DSU_PREDICTION
+    const auto& status = predicted_status;
+#else
+    const auto& status = gamepad_status;
+#endif
+    write_controller_data(packet, status, ++sequence.packet_number, subscriber.motion_batch != 0 ? &motion : nullptr);
+    return static_cast<uint16_t>(packet.cursor());
+}
+
+#ifdef DSU_FANOUT_WORKERS
+/**
+ * Encodes the round's sample for one subscriber into the lane's batch, sending the batch first if it's full
+ */
+void fanout_work::item(size_t lane, size_t index){
+    const auto& subscriber = snapshot->entries[index];
+    if (!wants_sample(subscriber, slot, now))
+        return;
+    auto& state = fanout_lanes[lane];
+    if (state.pending == FANOUT_BATCH)
+        flush_lane(state);
+    const auto position = state.pending++;
+    state.endpoints[position] = subscriber.remote_ep;
+    state.batch[position] = {state.buffers[position].data(), encode_sample(subscriber, state.buffers[position]), &state.endpoints[position]};
+}
+
+void fanout_work::done(size_t lane){
+    flush_lane(fanout_lanes[lane]);
+}
+
+/**
+ * Sends a lane's batch without blocking, a client whose datagram the socket refuses gets the next sample instead
+ */
+void flush_lane(fanout_lane& lane){
+    size_t done = 0;
+    uint32_t sent = 0;
+    while (done < lane.pending){
+        ssize_t result;
+        try {
+            result = lane.socket->send_batch({lane.batch.data() + done, lane.pending - done}, sockets::msg_flags::DONT_WAIT);
+        }
+        catch (const utils::errno_error&){
+            // Only the first datagram of the remainder can have failed, skip it and carry on with the rest
+            ++done;
+            continue;
+        }
+        if (result <= 0)
+            break;
+        done += result;
+        sent += result;
+    }
+    lane.sent.store(lane.sent.load(std::memory_order_relaxed) + sent, std::memory_order_relaxed);
+    lane.dropped.store(lane.dropped.load(std::memory_order_relaxed) + static_cast<uint32_t>(lane.pending - sent), std::memory_order_relaxed);
+    lane.pending = 0;
+}
+
+/**
+ * Logs how the fan-out work was spread, a lane stealing a lot means the shards are unbalanced
+ */
+void report_fanout(){
+    for (size_t lane = 0; lane < FANOUT_LANES; ++lane){
+        const auto& stats = fanout.stats(lane);
+        DEBUG_FUNCTION_LINE("Fan-out lane %u: {Subscribers: %u, Stolen chunks: %u, Sent: %u, Dropped: %u}", lane, stats.items.load(), stats.stolen.load(),
+                            fanout_lanes[lane].sent.load(), fanout_lanes[lane].dropped.load());
+    }
+}
+#endif
+
+#ifdef DSU_PREDICTION
+/**
+ * @param status a GamePad sample
+ * @param time when the sample was read
+ * @return the parts of the sample the predictor extrapolates
+ */
+DSU::InputSample to_input_sample(const VPADStatus& status, std::chrono::steady_clock::time_point time){
+    using DSU::InputChannel;
+    DSU::InputSample sample{time};
+    sample[InputChannel::ACCEL_X] = status.accelorometer.acc.x;
+    sample[InputChannel::ACCEL_Y] = status.accelorometer.acc.y;
+    sample[InputChannel::ACCEL_Z] = status.accelorometer.acc.z;
+    sample[InputChannel::GYRO_PITCH] = status.gyro.x;
+    sample[InputChannel::GYRO_YAW] = status.gyro.y;
+    sample[InputChannel::GYRO_ROLL] = status.gyro.z;
+    sample[InputChannel::LEFT_STICK_X] = status.leftStick.x;
+    sample[InputChannel::LEFT_STICK_Y] = status.leftStick.y;
+    sample[InputChannel::RIGHT_STICK_X] = status.rightStick.x;
+    sample[InputChannel::RIGHT_STICK_Y] = status.rightStick.y;
+    return sample;
+}
+
+/**
+ * Overwrites the extrapolated parts of a GamePad sample, buttons are left as they were read
+ */
+void apply_prediction(VPADStatus& status, const DSU::InputSample& sample){
+    using DSU::InputChannel;
+    status.accelorometer.acc.x = sample[InputChannel::ACCEL_X];
+    status.accelorometer.acc.y = sample[InputChannel::ACCEL_Y];
+    status.accelorometer.acc.z = sample[InputChannel::ACCEL_Z];
+    status.gyro.x = sample[InputChannel::GYRO_PITCH];
+    status.gyro.y = sample[InputChannel::GYRO_YAW];
+    status.gyro.z = sample[InputChannel::GYRO_ROLL];
+    status.leftStick.x = sample[InputChannel::LEFT_STICK_X];
+    status.leftStick.y = sample[InputChannel::LEFT_STICK_Y];
+    status.rightStick.x = sample[InputChannel::RIGHT_STICK_X];
+    status.rightStick.y = sample[InputChannel::RIGHT_STICK_Y];
+}
+#endif
+
+/**
+ * Writes the capture ring to CAPTURE_PATH and the trace ring to TRACE_PATH, overwriting the previous dumps
+ */
+void dump_diagnostics(){
+#ifdef DSU_CAPTURE
+    const auto datagrams = capture.write_pcap(CAPTURE_PATH);
+    if (datagrams < 0)
+        ERROR_FUNCTION_LINE("Failed to write capture to %s: %d", CAPTURE_PATH, datagrams);
+    else
+        INFO_FUNCTION_LINE("Wrote %d datagrams to %s", datagrams, CAPTURE_PATH);
+#endif
+#ifdef DSU_TRACE
+    const auto spans = utils::trace::write_json(TRACE_PATH);
+    if (spans < 0)
+        ERROR_FUNCTION_LINE("Failed to write trace to %s: %d", TRACE_PATH, spans);
+    else
+        INFO_FUNCTION_LINE("Wrote %d spans to %s", spans, TRACE_PATH);
+#endif
+}
+
+/**
+ * @param now the current time
+ * @return how busy the loop needs to be for the clients it currently has
+ */
+net::activity current_activity(std::chrono::steady_clock::time_point now){
+    if (registry.read(PUBLISHER)->count != 0 || (multicast.enabled && multicast_lease.active(now)))
+        return net::activity::STREAMING;
+#ifdef DSU_SHARED_MEMORY
+    if (shared_memory && shared_memory->active(net::subscription_index<MAX_CLIENTS>::TIMEOUT))
+        return net::activity::STREAMING;
+#endif
+    const std::chrono::steady_clock::time_point lastRequest{std::chrono::steady_clock::duration{last_request.load(std::memory_order_relaxed)}};
+    if (lastRequest != std::chrono::steady_clock::time_point{} && now - lastRequest < net::subscription_index<MAX_CLIENTS>::TIMEOUT)
+        return net::activity::CONTROL;
+    return net::activity::IDLE;
+}
+
+/**
+ * @param target the slot selection of a motor request, read the same way as a CONTROLLER_DATA registration
+ * @return a bit per slot the request is about
+ */
+uint8_t target_slots(const DSU::Packets::Incoming::ControllerData& target){
+    using DSU::RegistrationType;
+    if (target.registration_type == RegistrationType::SUBSCRIBE_ALL)
+        return (1u << net::MAX_SLOTS) - 1;
+    uint8_t slots = 0;
+    if ((target.registration_type & RegistrationType::SLOT_BASED) == RegistrationType::SLOT_BASED && target.reporting_slot < net::MAX_SLOTS)
+        slots |= 1u << target.reporting_slot;
+    if ((target.registration_type & RegistrationType::MAC_BASED) == RegistrationType::MAC_BASED){
+        // Disconnected slots all report the same empty address
+        for (uint8_t slot = 0; slot < net::MAX_SLOTS; ++slot){
+            const auto& head = responses.head(slot);
+            if (head.slot_state == DSU::SlotState::CONNECTED && head.mac_address == target.mac_address)
+                slots |= 1u << slot;
+        }
+    }
+    return slots;
+}
+
+/**
+ * Slot 0 is the GamePad, slots 1 to 3 are Wii Remotes 1 to 3, which can rumble even though they aren't reported as controllers
+ * @return the number of motors the slot can drive
+ */
+uint8_t motor_count(uint8_t slot){
+    if (slot == 0)
+        return 1;
+    WPADExtensionType extension;
+    return WPADProbe(static_cast<WPADChan>(slot - 1), &extension) == WPAD_ERROR_NONE ? 1 : 0;
+}
+
+/**
+ * Sets a slot's motor to its current rumble state
+ * @param slot the slot to drive
+ * @param now the current time, picks the on/off phase of a Wii Remote motor
+ */
+void drive_motor(uint8_t slot, std::chrono::steady_clock::time_point now){
+    const auto& rumble = rumble_slots[slot];
+    if (slot == 0){
+        if (rumble.intensity() == 0){
+            VPADStopMotor(VPADChan::VPAD_CHAN_0);
+            return;
+        }
+        auto pattern = DSU::MotorPattern::from_intensity(rumble.intensity());
+        VPADControlMotor(VPADChan::VPAD_CHAN_0, pattern.bits.data(), DSU::MotorPattern::BITS);
+        return;
+    }
+    // Wii Remote motors are either on or off, intensity becomes the share of each period they're on for
+    const auto on = rumble.switched_on(now);
+    WPADControlMotor(static_cast<WPADChan>(slot - 1), on ? 1 : 0);
+    motor_switched[slot] = on;
+}
+
+/**
+ * Keeps every rumbling motor going, called once per decode step
+ * @param now the current time
+ */
+void drive_motors(std::chrono::steady_clock::time_point now){
+    for (uint8_t slot = 0; slot < net::MAX_SLOTS; ++slot){
+        auto& rumble = rumble_slots[slot];
+        if (rumble.expire(now))
+            drive_motor(slot, now);
+        else if (slot == 0 ? rumble.refresh_due(now) : rumble.switched_on(now) != motor_switched[slot])
+            drive_motor(slot, now);
+    }
+}
+
+/**
+ * Logs how well the sampling stage kept to its rate since the last report
+ * @param stats the sampling stage's tick statistics
+ */
+void report_ticks(const utils::tick_stats& stats){
+    if (stats.ticks == 0)
+        return;
+    const auto& jitter = stats.jitter;
+    const auto& overruns = stats.overruns;
+    DEBUG_FUNCTION_LINE("Sampling ticks: %u, %u skipped, worst wake-up %u us late", stats.ticks, stats.skipped,
+                        static_cast<uint32_t>(stats.worst_lateness.count()));
+    DEBUG_FUNCTION_LINE("Tick jitter: {<=10us: %u, <=50us: %u, <=100us: %u, <=500us: %u, <=1ms: %u, more: %u}",
+                        jitter[0], jitter[1], jitter[2], jitter[3], jitter[4], jitter[5]);
+    if (overruns[0] + overruns[1] + overruns[2] + overruns[3] + overruns[4] != 0)
+        WARN_FUNCTION_LINE("Tick overruns by deadlines missed: {1: %u, 2: %u, 3-4: %u, 5-8: %u, more: %u}",
+                           overruns[0], overruns[1], overruns[2], overruns[3], overruns[4]);
+}
+
+/**
+ * Hands a client table entry to a new client, transmit reports what the previous owner lost on the way
+ * @param index the client table index being reused
+ */
+void release_client(size_t index){
+    coalescer.remove(index);
+    // The reset has to reach transmit before the new client's first reply, so wait for room
+    net::outbound_datagram* datagram;
+    while ((datagram = claim_outbound(control_out, net::outbound_command::RESET, net::datagram_kind::CONTROL, index, registry.generation(index), {})) == nullptr && running)
+        std::this_thread::yield();
+    if (datagram != nullptr)
+        control_out.publish();
+}
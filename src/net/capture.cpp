@@ -0,0 +1,141 @@
+#include "capture.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace sockets {
+    namespace {
+        constexpr uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+        // Raw IPv4 packets with no link layer header
+        constexpr uint32_t LINKTYPE_IPV4 = 228;
+        constexpr size_t IPV4_HEADER = 20;
+        constexpr size_t UDP_HEADER = 8;
+
+        // pcap headers are written in host order, readers work out the byte order from the magic
+        struct file_header {
+            uint32_t magic;
+            uint16_t version_major;
+            uint16_t version_minor;
+            int32_t this_zone;
+            uint32_t sig_figs;
+            uint32_t snap_length;
+            uint32_t link_type;
+        };
+
+        struct record_header {
+            uint32_t seconds;
+            uint32_t microseconds;
+            uint32_t captured_length;
+            uint32_t original_length;
+        };
+
+        void put16(uint8_t* out, uint16_t value) {
+            out[0] = static_cast<uint8_t>(value >> 8);
+            out[1] = static_cast<uint8_t>(value);
+        }
+
+        void put32(uint8_t* out, uint32_t value) {
+            put16(out, static_cast<uint16_t>(value >> 16));
+            put16(out + 2, static_cast<uint16_t>(value));
+        }
+
+        /**
+         * Writes the IPv4 and UDP headers a datagram would have had on the wire, the UDP checksum is left out as IPv4 allows
+         */
+        void write_headers(uint8_t* out, uint32_t source, uint16_t sourcePort, uint32_t destination, uint16_t destinationPort, size_t payloadLength) {
+            const auto total = static_cast<uint16_t>(IPV4_HEADER + UDP_HEADER + payloadLength);
+            std::memset(out, 0, IPV4_HEADER + UDP_HEADER);
+            out[0] = 0x45;
+            put16(out + 2, total);
+            out[8] = 64;
+            out[9] = IPPROTO_UDP;
+            put32(out + 12, source);
+            put32(out + 16, destination);
+            uint32_t sum = 0;
+            for (size_t i = 0; i < IPV4_HEADER; i += 2)
+                sum += (out[i] << 8) | out[i + 1];
+            while (sum > 0xFFFF)
+                sum = (sum & 0xFFFF) + (sum >> 16);
+            put16(out + 10, static_cast<uint16_t>(~sum));
+
+            auto* const udp = out + IPV4_HEADER;
+            put16(udp, sourcePort);
+            put16(udp + 2, destinationPort);
+            put16(udp + 4, static_cast<uint16_t>(UDP_HEADER + payloadLength));
+        }
+    }
+
+    void capture_ring::set_local(const endpoint& local_ep) {
+        m_local_address = local_ep.address_value();
+        m_local_port = local_ep.port();
+    }
+
+    void capture_ring::record(capture_direction direction, const endpoint& remote_ep, const uint8_t* data, size_t length) {
+        const auto index = m_written.fetch_add(1, std::memory_order_relaxed);
+        auto& slot = m_entries[index % CAPACITY];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.time_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        slot.remote_address = remote_ep.address_value();
+        slot.remote_port = remote_ep.port();
+        slot.length = static_cast<uint16_t>(std::min<size_t>(length, UINT16_MAX));
+        slot.direction = direction;
+        std::memcpy(slot.data.data(), data, std::min(length, SNAP_LENGTH));
+        slot.sequence.store(index + 1, std::memory_order_release);
+    }
+
+    size_t capture_ring::write_pcap(std::FILE* file) const {
+        const file_header header{PCAP_MAGIC, 2, 4, 0, 0, SNAP_LENGTH + IPV4_HEADER + UDP_HEADER, LINKTYPE_IPV4};
+        std::fwrite(&header, sizeof(header), 1, file);
+
+        const auto last = m_written.load(std::memory_order_acquire);
+        const auto first = last - std::min<uint64_t>(last, CAPACITY);
+        std::array<uint8_t, IPV4_HEADER + UDP_HEADER> headers{};
+        std::array<uint8_t, SNAP_LENGTH> payload{};
+        size_t count = 0;
+        for (auto i = first; i < last; ++i) {
+            const auto& slot = m_entries[i % CAPACITY];
+            if (slot.sequence.load(std::memory_order_acquire) != i + 1)
+                continue;
+            const auto timeUs = slot.time_us;
+            const auto remoteAddress = slot.remote_address;
+            const auto remotePort = slot.remote_port;
+            const auto length = slot.length;
+            const auto direction = slot.direction;
+            const auto captured = std::min<size_t>(length, SNAP_LENGTH);
+            std::memcpy(payload.data(), slot.data.data(), captured);
+            // Overwritten while it was being copied, the fence keeps the copy from moving past the check
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != i + 1)
+                continue;
+
+            const record_header recordHeader{static_cast<uint32_t>(timeUs / 1000000), static_cast<uint32_t>(timeUs % 1000000),
+                                             static_cast<uint32_t>(headers.size() + captured), static_cast<uint32_t>(headers.size() + length)};
+            if (direction == capture_direction::INBOUND)
+                write_headers(headers.data(), remoteAddress, remotePort, m_local_address, m_local_port, length);
+            else
+                write_headers(headers.data(), m_local_address, m_local_port, remoteAddress, remotePort, length);
+            std::fwrite(&recordHeader, sizeof(recordHeader), 1, file);
+            std::fwrite(headers.data(), headers.size(), 1, file);
+            std::fwrite(payload.data(), captured, 1, file);
+            ++count;
+        }
+        return count;
+    }
+
+    ssize_t capture_ring::write_pcap(const char* path) const {
+        auto* const file = std::fopen(path, "wb");
+        if (file == nullptr)
+            return -errno;
+        const auto count = write_pcap(file);
+        if (std::fclose(file) != 0)
+            return -errno;
+        return static_cast<ssize_t>(count);
+    }
+
+    size_t capture_ring::size() const {
+        return static_cast<size_t>(std::min<uint64_t>(m_written.load(std::memory_order_relaxed), CAPACITY));
+    }
+}
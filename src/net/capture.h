@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "endpoint.h"
+
+#ifndef DSU_CAPTURE_RECORDS
+#define DSU_CAPTURE_RECORDS 512
+#endif
+
+namespace sockets {
+    enum class capture_direction : uint8_t {
+        INBOUND,
+        OUTBOUND
+    };
+
+    /**
+     * Keeps the most recent datagrams seen by a socket in a fixed ring, so they can be written out as a pcap file after the fact.
+     * Recording is a bounded copy and never allocates. Several threads may record at once, each claims its own entry,
+     * and entries still being written when the ring is dumped are left out.
+     */
+    class capture_ring {
+    public:
+        static constexpr size_t CAPACITY = DSU_CAPTURE_RECORDS;
+        // Every DSU datagram fits, anything longer is truncated like tcpdump -s would
+        static constexpr size_t SNAP_LENGTH = 256;
+
+        /**
+         * @param local_ep the address the socket is bound to, used as the other end of every captured datagram
+         */
+        void set_local(const endpoint& local_ep);
+
+        /**
+         * Copies a datagram into the ring, overwriting the oldest one when full
+         * @param direction whether the datagram was received or sent
+         * @param remote_ep the endpoint the datagram came from or went to
+         * @param data the datagram
+         * @param length the length of the datagram
+         */
+        void record(capture_direction direction, const endpoint& remote_ep, const uint8_t* data, size_t length);
+
+        /**
+         * Writes everything in the ring, oldest first, as a pcap file of raw IPv4 packets. The ring is left as it was.
+         * @param file an open file to write to
+         * @return the number of datagrams written
+         */
+        size_t write_pcap(std::FILE* file) const;
+
+        /**
+         * @param path the file to create or replace
+         * @return the number of datagrams written, or a negative error (see errno) if the file couldn't be written
+         */
+        ssize_t write_pcap(const char* path) const;
+
+        [[nodiscard]] size_t size() const;
+
+    private:
+        struct entry {
+            // Index + 1 of the datagram stored here, zero while it's being written
+            std::atomic<uint64_t> sequence{0};
+            uint64_t time_us;
+            uint32_t remote_address;
+            uint16_t remote_port;
+            uint16_t length;
+            capture_direction direction;
+            std::array<uint8_t, SNAP_LENGTH> data;
+        };
+
+        std::array<entry, CAPACITY> m_entries{};
+        std::atomic<uint64_t> m_written{0};
+        uint32_t m_local_address = 0;
+        uint16_t m_local_port = 0;
+    };
+}
@@ -1,11 +1,12 @@
 #pragma once
 #include "endpoint.h"
 #include <bits/functional_hash.h>
+#include <chrono>
 namespace net {
     struct client  {
         sockets::endpoint remote_ep{};
-        uint32_t client_id;
-        uint32_t packet_number;
+        uint32_t client_id{};
+        std::chrono::steady_clock::time_point last_seen{};
 
     };
 }
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "client_table.hpp"
+#include "subscriptions.hpp"
+
+namespace net {
+    /**
+     * What the publisher needs to know about one subscribed client
+     */
+    struct subscriber {
+        uint16_t client = 0;
+        // Changes whenever the client table entry is handed to a new client, so per-client publisher state can be reset
+        uint16_t generation = 0;
+        uint8_t slots = 0;
+        sockets::endpoint remote_ep{};
+        std::array<std::chrono::steady_clock::time_point, MAX_SLOTS> expiry{};
+        // Motion samples per MOTION_BATCH_DATA datagram, 0 for plain CONTROLLER_DATA
+        uint8_t motion_batch = 0;
+
+        /**
+         * @return whether the registration for the slot is still live
+         */
+        [[nodiscard]] bool subscribed(uint8_t slot, std::chrono::steady_clock::time_point now) const {
+            return (slots & (1u << slot)) != 0 && now < expiry[slot];
+        }
+    };
+
+    /**
+     * Immutable list of subscribers, replaced as a whole whenever a registration changes
+     */
+    template <size_t Capacity>
+    struct registry_snapshot {
+        std::array<subscriber, Capacity> entries{};
+        size_t count = 0;
+
+        [[nodiscard]] const subscriber* begin() const {
+            return entries.data();
+        }
+
+        [[nodiscard]] const subscriber* end() const {
+            return entries.data() + count;
+        }
+    };
+
+    /**
+     * Clients and their subscriptions, changed by a single writer thread and read by publisher threads.
+     * The writer owns the client table and subscription index outright and publishes an immutable snapshot of the subscribers
+     * once per batch of changes. Readers pin the current snapshot with a hazard slot each, the writer only ever rebuilds a buffer
+     * that is neither current nor pinned, and with Readers + 2 buffers there is always one free, so neither side waits on the other.
+     * @tparam Capacity the most clients tracked at once
+     * @tparam Readers the number of publisher threads, each needs its own reader index
+     */
+    template <size_t Capacity, size_t Readers = 1>
+    class client_registry {
+        static constexpr size_t BUFFERS = Readers + 2;
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        // Writer side
+        client_table<Capacity> m_clients;
+        subscription_index<Capacity> m_subscriptions;
+        std::array<uint16_t, Capacity> m_generations{};
+        std::array<uint8_t, Capacity> m_motion_batches{};
+        bool m_dirty = false;
+
+        std::array<registry_snapshot<Capacity>, BUFFERS> m_snapshots{};
+        std::atomic<uint32_t> m_current{0};
+        std::array<std::atomic<uint32_t>, Readers> m_hazards{};
+    public:
+        /**
+         * Pins a snapshot for as long as it lives
+         */
+        class reader_guard {
+            client_registry* m_registry;
+            size_t m_reader;
+            const registry_snapshot<Capacity>* m_snapshot;
+        public:
+            reader_guard(client_registry& registry, size_t reader, const registry_snapshot<Capacity>& snapshot)
+            : m_registry(&registry), m_reader(reader), m_snapshot(&snapshot) {}
+
+            reader_guard(const reader_guard&) = delete;
+            reader_guard& operator=(const reader_guard&) = delete;
+
+            ~reader_guard() {
+                m_registry->m_hazards[m_reader].store(NONE, std::memory_order_release);
+            }
+
+            const registry_snapshot<Capacity>& operator*() const {
+                return *m_snapshot;
+            }
+
+            const registry_snapshot<Capacity>* operator->() const {
+                return m_snapshot;
+            }
+        };
+
+        client_registry() {
+            for (auto& hazard : m_hazards)
+                hazard.store(NONE, std::memory_order_relaxed);
+        }
+
+        /**
+         * Pins the newest snapshot, never blocks
+         * @param reader this thread's reader index, below Readers and not shared with another thread
+         */
+        reader_guard read(size_t reader) {
+            auto current = m_current.load(std::memory_order_acquire);
+            while (true) {
+                m_hazards[reader].store(current, std::memory_order_seq_cst);
+                // The writer may have started reusing the buffer before the hazard was visible
+                const auto check = m_current.load(std::memory_order_seq_cst);
+                if (check == current)
+                    break;
+                current = check;
+            }
+            return reader_guard{*this, reader, m_snapshots[current]};
+        }
+
+        // Everything below is for the writer thread only
+
+        client* find(const sockets::endpoint& ep) {
+            return m_clients.find(ep);
+        }
+
+        /**
+         * @return the generation of a client table entry, the one its subscriber entries carry
+         */
+        [[nodiscard]] uint16_t generation(size_t client) const {
+            return m_generations[client];
+        }
+
+        /**
+         * Registers a new client, replacing the least recently seen one when full
+         * @return the index of the stored client
+         */
+        size_t insert(const client& entry) {
+            const auto index = m_clients.index_of(m_clients.insert(entry));
+            ++m_generations[index];
+            m_subscriptions.remove(index);
+            m_motion_batches[index] = 0;
+            m_dirty = true;
+            return index;
+        }
+
+        /**
+         * Adds or refreshes a client's registrations
+         */
+        void subscribe(size_t client, const DSU::Packets::Incoming::ControllerData& request, std::chrono::steady_clock::time_point now) {
+            m_subscriptions.subscribe(client, request, now);
+            m_dirty = true;
+        }
+
+        /**
+         * @param client the client table index
+         * @param samples motion samples per datagram the client negotiated, 0 for plain CONTROLLER_DATA
+         */
+        void set_motion_batch(size_t client, uint8_t samples) {
+            m_dirty |= m_motion_batches[client] != samples;
+            m_motion_batches[client] = samples;
+        }
+
+        void set_slot_mac(uint8_t slot, const DSU::MacAddress& mac) {
+            m_subscriptions.set_slot_mac(slot, mac);
+        }
+
+        /**
+         * Drops lapsed registrations, the snapshot is only rebuilt if something was dropped
+         */
+        void expire(std::chrono::steady_clock::time_point now) {
+            m_dirty |= m_subscriptions.expire(now);
+        }
+
+        /**
+         * Makes the changes since the last call visible to readers
+         */
+        void publish() {
+            if (!m_dirty)
+                return;
+            m_dirty = false;
+
+            const auto current = m_current.load(std::memory_order_relaxed);
+            uint32_t target = 0;
+            for (; target < BUFFERS; ++target) {
+                if (target != current && !pinned(target))
+                    break;
+            }
+
+            auto& snapshot = m_snapshots[target];
+            snapshot.count = 0;
+            for (size_t index = 0; index < m_clients.size(); ++index) {
+                const auto slots = m_subscriptions.slot_mask(index);
+                if (slots == 0)
+                    continue;
+                auto& entry = snapshot.entries[snapshot.count++];
+                entry.client = static_cast<uint16_t>(index);
+                entry.generation = m_generations[index];
+                entry.slots = slots;
+                entry.remote_ep = m_clients[index].remote_ep;
+                entry.motion_batch = m_motion_batches[index];
+                for (size_t slot = 0; slot < MAX_SLOTS; ++slot)
+                    entry.expiry[slot] = m_subscriptions.expiry(index, slot);
+            }
+            m_current.store(target, std::memory_order_seq_cst);
+        }
+
+        /**
+         * @return whether any client is registered for any slot, as of the writer's latest changes
+         */
+        [[nodiscard]] bool any() const {
+            return m_subscriptions.any();
+        }
+
+        client_table<Capacity>& clients() {
+            return m_clients;
+        }
+
+    private:
+        bool pinned(uint32_t buffer) const {
+            for (const auto& hazard : m_hazards) {
+                if (hazard.load(std::memory_order_seq_cst) == buffer)
+                    return true;
+            }
+            return false;
+        }
+    };
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+#include "client.hpp"
+
+namespace net {
+    /**
+     * Fixed capacity client registry, storage is reserved up front so new clients never allocate.
+     * Lookups scan a contiguous array of endpoint keys, which beats hashing at the client counts a console serves.
+     * @tparam Capacity the most clients tracked at once, the least recently seen one is replaced when full
+     */
+    template <size_t Capacity>
+    class client_table {
+        std::array<uint64_t, Capacity> m_keys{};
+        std::array<client, Capacity> m_clients{};
+        size_t m_count = 0;
+    public:
+        /**
+         * @return the client registered for the endpoint, nullptr if there isn't one
+         */
+        client* find(const sockets::endpoint& ep) {
+            const auto key = ep.comparison_value();
+            for (size_t i = 0; i < m_count; ++i) {
+                if (m_keys[i] == key)
+                    return &m_clients[i];
+            }
+            return nullptr;
+        }
+
+        /**
+         * Registers a client that isn't in the table yet
+         * @param entry the new client
+         * @return the stored client
+         */
+        client& insert(const client& entry) {
+            size_t index = m_count;
+            if (m_count == Capacity) {
+                index = 0;
+                for (size_t i = 1; i < m_count; ++i) {
+                    if (m_clients[i].last_seen < m_clients[index].last_seen)
+                        index = i;
+                }
+            }
+            else {
+                ++m_count;
+            }
+            m_keys[index] = entry.remote_ep.comparison_value();
+            m_clients[index] = entry;
+            return m_clients[index];
+        }
+
+        /**
+         * @return the index of a client stored in this table, stable until the client is replaced
+         */
+        [[nodiscard]] size_t index_of(const client& entry) const {
+            return &entry - m_clients.data();
+        }
+
+        client& operator[](size_t index) {
+            return m_clients[index];
+        }
+
+        [[nodiscard]] size_t size() const {
+            return m_count;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return m_count == 0;
+        }
+
+        [[nodiscard]] static constexpr size_t capacity() {
+            return Capacity;
+        }
+
+        client* begin() {
+            return m_clients.data();
+        }
+
+        client* end() {
+            return m_clients.data() + m_count;
+        }
+    };
+}
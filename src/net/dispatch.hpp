@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "../dsu/DsuInfo.hpp"
+
+namespace net {
+    // Message codes are 0x1000xx for the base protocol and its extensions and 0x1100xx for motors,
+    // so bit 16 of the family plus the low nibble tells every known code apart
+    constexpr size_t DISPATCH_SLOTS = 32;
+
+    constexpr size_t dispatch_index(DSU::DSUMessageType type) {
+        const auto code = static_cast<uint32_t>(type);
+        return ((code >> 12) & 0x10) | (code & 0xF);
+    }
+
+    template <typename Context>
+    struct message_handler {
+        DSU::DSUMessageType type = DSU::DSUMessageType::INVALID;
+        void (*handle)(Context&) = nullptr;
+    };
+
+    /**
+     * Maps message types to their handlers with one indexed lookup, built at compile time.
+     * Two handlers landing on the same index fail the build, a type that isn't registered is rejected after one comparison.
+     * @tparam Context what a handler is given, the parsed header and whatever else it needs
+     */
+    template <typename Context>
+    class dispatch_table {
+        std::array<message_handler<Context>, DISPATCH_SLOTS> m_entries{};
+    public:
+        template <size_t Count>
+        consteval explicit dispatch_table(const std::array<message_handler<Context>, Count>& handlers) {
+            for (const auto& handler : handlers) {
+                const auto code = static_cast<uint32_t>(handler.type);
+                if ((code & ~0x1000Fu) != 0x100000u)
+                    throw std::logic_error("message type outside the dispatchable families");
+                auto& entry = m_entries[dispatch_index(handler.type)];
+                if (entry.handle != nullptr)
+                    throw std::logic_error("two handlers for the same dispatch index");
+                entry = handler;
+            }
+        }
+
+        /**
+         * @param type the message type from the header
+         * @return the handler, nullptr if the type has none
+         */
+        [[nodiscard]] constexpr auto find(DSU::DSUMessageType type) const -> void (*)(Context&) {
+            const auto& entry = m_entries[dispatch_index(type)];
+            return entry.type == type ? entry.handle : nullptr;
+        }
+    };
+}
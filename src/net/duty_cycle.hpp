@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace net {
+    enum class activity : uint8_t {
+        // Nobody has sent anything recently, the loop sleeps on the socket
+        IDLE,
+        // Clients are asking for versions and slot info but nobody wants data, input isn't sampled
+        CONTROL,
+        // At least one data subscription or multicast listener, full sampling and publish rate
+        STREAMING
+    };
+
+    constexpr const char* to_string(activity mode) {
+        switch (mode) {
+            case activity::IDLE:
+                return "IDLE";
+            case activity::CONTROL:
+                return "CONTROL";
+            default:
+                return "STREAMING";
+        }
+    }
+
+    /**
+     * Tracks how busy the server needs to be and for how long it has been in each state
+     */
+    class duty_cycle {
+        using clock = std::chrono::steady_clock;
+
+        activity m_mode = activity::IDLE;
+        clock::time_point m_since{};
+        clock::time_point m_last_sample{};
+        std::array<uint32_t, 3> m_entered{};
+        std::array<clock::duration, 3> m_time{};
+    public:
+        // Longest the loop sleeps on the socket, bounds how late shutdown is noticed
+        static constexpr auto IDLE_WAIT = std::chrono::milliseconds(100);
+        static constexpr auto CONTROL_WAIT = std::chrono::milliseconds(20);
+        // Without subscribers the GamePad is only read to keep the battery level in info replies current
+        static constexpr auto CONTROL_SAMPLE_INTERVAL = std::chrono::seconds(1);
+
+        explicit duty_cycle(clock::time_point now)
+        : m_since(now) {
+            m_entered[static_cast<size_t>(m_mode)] = 1;
+        }
+
+        /**
+         * @param next the activity the server currently needs
+         * @param now the current time
+         * @return whether the mode changed
+         */
+        bool update(activity next, clock::time_point now) {
+            if (next == m_mode)
+                return false;
+            m_time[static_cast<size_t>(m_mode)] += now - m_since;
+            m_mode = next;
+            m_since = now;
+            ++m_entered[static_cast<size_t>(next)];
+            return true;
+        }
+
+        /**
+         * @return whether input should be sampled this iteration
+         */
+        bool should_sample(clock::time_point now) {
+            if (m_mode == activity::STREAMING || (m_mode == activity::CONTROL && now - m_last_sample >= CONTROL_SAMPLE_INTERVAL)) {
+                m_last_sample = now;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @return how long the loop may block waiting for a datagram, zero while streaming
+         */
+        [[nodiscard]] std::chrono::milliseconds wait_timeout() const {
+            switch (m_mode) {
+                case activity::IDLE:
+                    return IDLE_WAIT;
+                case activity::CONTROL:
+                    return CONTROL_WAIT;
+                default:
+                    return std::chrono::milliseconds(0);
+            }
+        }
+
+        [[nodiscard]] activity mode() const {
+            return m_mode;
+        }
+
+        /**
+         * @return how many times the mode has been entered, counting the initial IDLE
+         */
+        [[nodiscard]] uint32_t entered(activity mode) const {
+            return m_entered[static_cast<size_t>(mode)];
+        }
+
+        /**
+         * @return the total time spent in a mode, including the current stretch
+         */
+        [[nodiscard]] clock::duration time_in(activity mode, clock::time_point now) const {
+            auto total = m_time[static_cast<size_t>(mode)];
+            if (mode == m_mode)
+                total += now - m_since;
+            return total;
+        }
+    };
+}
@@ -48,7 +48,7 @@ namespace sockets {
 
         explicit endpoint(const sockaddr_storage& storage)
         : m_address_in() {
-            std::memcpy(&m_address_in, &storage, sizeof(storage));
+            std::memcpy(&m_address_in, &storage, sizeof(m_address_in));
         }
 
         /**
@@ -95,6 +95,14 @@ namespace sockets {
             return inet_ntoa(m_address_in.sin_addr);
         }
 
+        /**
+         *
+         * @return The address of this endpoint in host order
+         */
+        [[nodiscard]] in_addr_t address_value() const {
+            return ntohl(m_address_in.sin_addr.s_addr);
+        }
+
         auto operator <=> (const endpoint& ep) const{
             const auto thisValue = comparison_value();
             const auto thatValue = ep.comparison_value();
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#ifdef __linux__
+#include "udp_socket.h"
+#endif
+
+namespace net {
+    /**
+     * What one lane has done, written by the lane and readable from any thread
+     */
+    struct fanout_lane_stats {
+        std::atomic<uint32_t> items{0};
+        // Chunks taken from another lane's shard
+        std::atomic<uint32_t> stolen{0};
+    };
+
+    /**
+     * Splits each round of fan-out work across a fixed set of lanes, one thread each.
+     * A round is a list of items, lane i owns the i-th contiguous shard of it and claims its shard in chunks. A lane that has
+     * finished its own shard goes on to claim chunks from the others, so a shard full of expensive items doesn't hold up the round.
+     * Lane 0 is the coordinator, it starts each round, works it like the others and returns once every lane is done,
+     * so whatever the items refer to only has to stay put for the duration of run.
+     * @tparam Lanes the number of threads working a round, the coordinator included
+     */
+    template <size_t Lanes>
+    class fanout_rounds {
+        static_assert(Lanes > 0, "a round needs at least the coordinator");
+
+        // Enough items per claim to amortise the atomic, few enough to leave something to steal
+        static constexpr size_t CHUNK = 8;
+
+        struct alignas(64) shard {
+            std::atomic<size_t> next{0};
+            size_t end = 0;
+        };
+
+        std::array<shard, Lanes> m_shards{};
+        alignas(64) std::atomic<uint32_t> m_round{0};
+        alignas(64) std::atomic<uint32_t> m_pending{0};
+        std::atomic<bool> m_stopped{false};
+        std::array<fanout_lane_stats, Lanes> m_stats{};
+    public:
+        /**
+         * Coordinator only, works a round of items with every lane and waits for it to complete
+         * @param count the number of items in the round
+         * @param work called as work.item(lane, index) for every item exactly once, then as work.done(lane) by each lane
+         */
+        template <typename Work>
+        void run(size_t count, Work& work) {
+            for (size_t lane = 0; lane < Lanes; ++lane) {
+                m_shards[lane].next.store(count * lane / Lanes, std::memory_order_relaxed);
+                m_shards[lane].end = count * (lane + 1) / Lanes;
+            }
+            m_pending.store(Lanes - 1, std::memory_order_relaxed);
+            m_round.fetch_add(1, std::memory_order_release);
+            m_round.notify_all();
+
+            drain(0, work);
+            // The others are on their last chunks by now, or stealing what's left of this one
+            while (m_pending.load(std::memory_order_acquire) != 0)
+                std::this_thread::yield();
+        }
+
+        /**
+         * Lanes other than the coordinator, sleeps until the next round and does its share of it
+         * @param lane this thread's lane, 1 to Lanes - 1
+         * @param seen the last round this lane worked, starts at 0
+         * @param work as for run
+         * @return false once the rounds have been stopped
+         */
+        template <typename Work>
+        bool work(size_t lane, uint32_t& seen, Work& work) {
+            m_round.wait(seen, std::memory_order_acquire);
+            seen = m_round.load(std::memory_order_acquire);
+            if (m_stopped.load(std::memory_order_acquire))
+                return false;
+            drain(lane, work);
+            m_pending.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Wakes every lane so it returns from work, call once the coordinator has stopped starting rounds
+         */
+        void stop() {
+            m_stopped.store(true, std::memory_order_release);
+            m_round.fetch_add(1, std::memory_order_release);
+            m_round.notify_all();
+        }
+
+        [[nodiscard]] const fanout_lane_stats& stats(size_t lane) const {
+            return m_stats[lane];
+        }
+
+    private:
+        template <typename Work>
+        void drain(size_t lane, Work& work) {
+            uint32_t items = 0;
+            uint32_t stolen = 0;
+            for (size_t offset = 0; offset < Lanes; ++offset) {
+                auto& shard = m_shards[(lane + offset) % Lanes];
+                while (true) {
+                    const auto begin = shard.next.fetch_add(CHUNK, std::memory_order_relaxed);
+                    if (begin >= shard.end)
+                        break;
+                    const auto end = std::min(begin + CHUNK, shard.end);
+                    for (auto index = begin; index < end; ++index)
+                        work.item(lane, index);
+                    items += static_cast<uint32_t>(end - begin);
+                    stolen += offset != 0;
+                }
+            }
+            work.done(lane);
+
+            auto& stats = m_stats[lane];
+            stats.items.store(stats.items.load(std::memory_order_relaxed) + items, std::memory_order_relaxed);
+            stats.stolen.store(stats.stolen.load(std::memory_order_relaxed) + stolen, std::memory_order_relaxed);
+        }
+    };
+
+#ifdef __linux__
+    /**
+     * Steers every datagram arriving at a SO_REUSEPORT group to the socket bound first, so sockets that join the group
+     * only to send from the server port never take requests away from the one being read
+     * @param socket any socket of the group, the program applies to all of them
+     */
+    inline void steer_to_first(sockets::udp_socket& socket) {
+        // A classic BPF program returning the index of the socket to deliver to
+        static sock_filter program[]{{BPF_RET | BPF_K, 0, 0, 0}};
+        const sock_fprog filter{1, program};
+        socket.set_option<sockets::options::attach_reuseport_cbpf>(filter);
+    }
+#endif
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "subscriptions.hpp"
+#include "udp_socket.h"
+
+namespace net {
+    /**
+     * Opt-in publishing of controller data to a single IPv4 multicast group,
+     * so the per-tick send cost doesn't grow with the number of listeners
+     */
+    struct multicast_config {
+        bool enabled = false;
+        sockets::endpoint group{};
+        // 1 keeps the traffic on the local segment
+        uint8_t ttl = 1;
+        // Whether listeners on this host receive the group traffic
+        bool loopback = false;
+    };
+
+    /**
+     * Sets up the socket for sending to the configured group
+     * @param socket the socket data will be published from
+     * @param config the multicast group and scope
+     */
+    inline void apply_multicast(sockets::udp_socket& socket, const multicast_config& config) {
+        if (!config.enabled)
+            return;
+#ifdef IP_MULTICAST_TTL
+        socket.set_option<sockets::options::multicast_ttl>(config.ttl);
+#endif
+#ifdef IP_MULTICAST_LOOP
+        socket.set_option<sockets::options::multicast_loop>(config.loopback ? 1 : 0);
+#endif
+    }
+
+    /**
+     * Tracks whether anyone has asked for the group recently, publishing stops once every listener has gone quiet.
+     * Renewed by the thread handling requests and checked by the one publishing.
+     */
+    class multicast_lease {
+        std::atomic<std::chrono::steady_clock::rep> m_expiry{0};
+    public:
+        static constexpr auto DURATION = subscription_index<>::TIMEOUT;
+
+        void renew(std::chrono::steady_clock::time_point now) {
+            m_expiry.store((now + DURATION).time_since_epoch().count(), std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] bool active(std::chrono::steady_clock::time_point now) const {
+            return now.time_since_epoch().count() < m_expiry.load(std::memory_order_relaxed);
+        }
+    };
+}
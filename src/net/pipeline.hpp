@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+#include "endpoint.h"
+#include "send_queue.hpp"
+#include "../utils/pinned_thread.h"
+
+namespace net {
+    /**
+     * A datagram on its way from the receive stage to decoding
+     */
+    struct inbound_datagram {
+        std::array<uint8_t, MAX_DATAGRAM> data{};
+        uint16_t length = 0;
+        sockets::endpoint remote_ep{};
+        std::chrono::steady_clock::time_point received{};
+    };
+
+    enum class outbound_command : uint8_t {
+        // Queue the datagram for a client
+        SEND,
+        // Send the datagram to the multicast group straight away
+        MULTICAST,
+        // The client table entry changed hands, forget what was queued for it and refuse anything older than its generation
+        RESET
+    };
+
+    /**
+     * A datagram, or an instruction about a client's queue, on its way to the transmit stage
+     */
+    struct outbound_datagram {
+        outbound_command command = outbound_command::SEND;
+        datagram_kind kind = datagram_kind::CONTROL;
+        uint16_t client = 0;
+        // The registry generation of the client table entry, data encoded before the entry changed hands carries the old one
+        uint16_t generation = 0;
+        uint16_t length = 0;
+        sockets::endpoint remote_ep{};
+        // A cached reply goes to the send queue as it is, otherwise the datagram is encoded into data
+        shared_datagram shared{};
+        std::array<uint8_t, MAX_DATAGRAM> data{};
+    };
+
+    /**
+     * How a stage spends its iterations, a stage that's never idle is the bottleneck
+     */
+    struct stage_stats {
+        std::atomic<uint32_t> busy{0};
+        std::atomic<uint32_t> idle{0};
+    };
+
+    /**
+     * Spins briefly when a stage runs out of work, then yields, then sleeps, so an idle stage gives its core back
+     */
+    class idle_backoff {
+        static constexpr uint32_t SPINS = 64;
+        static constexpr uint32_t YIELDS = 64;
+        static constexpr auto SLEEP = std::chrono::microseconds(250);
+
+        uint32_t m_idle = 0;
+    public:
+        void reset() {
+            m_idle = 0;
+        }
+
+        void idle() {
+            ++m_idle;
+            if (m_idle < SPINS)
+                return;
+            if (m_idle < SPINS + YIELDS)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(SLEEP);
+        }
+    };
+
+    /**
+     * Runs a stage on its own thread until running is cleared
+     * @param placement the core and priority of the stage
+     * @param running cleared to stop the stage
+     * @param stats counts busy and idle iterations
+     * @param step does one batch of work, returns whether there was any
+     */
+    template <typename Step>
+    utils::pinned_thread start_stage(const utils::thread_placement& placement, const std::atomic<bool>& running, stage_stats& stats, Step step) {
+        return utils::pinned_thread(placement, [&running, &stats, step = std::move(step)]() mutable {
+            idle_backoff backoff;
+            while (running.load(std::memory_order_relaxed)) {
+                if (step()) {
+                    stats.busy.store(stats.busy.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    backoff.reset();
+                }
+                else {
+                    stats.idle.store(stats.idle.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    backoff.idle();
+                }
+            }
+        });
+    }
+}
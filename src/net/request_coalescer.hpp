@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "../dsu/DsuPacket.hpp"
+
+namespace net {
+    /**
+     * Identifies requests that would get the same answer, the message type plus whatever part of the body matters
+     */
+    struct request_key {
+        DSU::DSUMessageType type{};
+        uint64_t detail = 0;
+
+        bool operator==(const request_key&) const = default;
+
+        /**
+         * @return the key of a CONTROLLER_DATA registration, two registrations with the same key subscribe to the same slots
+         */
+        static request_key registration(const DSU::Packets::Incoming::ControllerData& request) {
+            uint64_t detail = 0;
+            std::memcpy(&detail, &request.mac_address, sizeof(request.mac_address));
+            detail |= static_cast<uint64_t>(request.reporting_slot) << 48;
+            detail |= static_cast<uint64_t>(request.registration_type) << 56;
+            return {DSU::DSUMessageType::CONTROLLER_DATA, detail};
+        }
+    };
+
+    struct coalesce_stats {
+        // Requests that were answered
+        uint32_t handled = 0;
+        // Requests dropped because the same client already asked the same thing this tick
+        uint32_t coalesced = 0;
+    };
+
+    /**
+     * Remembers which requests each client has had answered during the current loop iteration,
+     * so a burst of repeats is answered once per tick
+     * @tparam Capacity the capacity of the client table, clients are identified by their index in it
+     */
+    template <size_t Capacity>
+    class request_coalescer {
+        // A version, a group and four slot requests, plus a couple of distinct registrations
+        static constexpr size_t KEYS_PER_CLIENT = 8;
+
+        struct tick_state {
+            std::array<request_key, KEYS_PER_CLIENT> keys{};
+            uint8_t count = 0;
+            bool touched = false;
+        };
+
+        std::array<tick_state, Capacity> m_states{};
+        std::array<uint16_t, Capacity> m_touched{};
+        size_t m_touched_count = 0;
+        coalesce_stats m_stats{};
+    public:
+        /**
+         * Forgets the previous tick, only the clients that sent something are cleared
+         */
+        void begin_tick() {
+            for (size_t i = 0; i < m_touched_count; ++i)
+                m_states[m_touched[i]] = tick_state{};
+            m_touched_count = 0;
+        }
+
+        /**
+         * @param client the index of the requesting client
+         * @param key what the request asks for
+         * @return whether the request should be answered, false if the client already asked for the same thing this tick
+         */
+        bool admit(size_t client, const request_key& key) {
+            auto& state = m_states[client];
+            for (uint8_t i = 0; i < state.count; ++i) {
+                if (state.keys[i] == key) {
+                    ++m_stats.coalesced;
+                    return false;
+                }
+            }
+            ++m_stats.handled;
+            if (!state.touched) {
+                state.touched = true;
+                m_touched[m_touched_count++] = static_cast<uint16_t>(client);
+            }
+            // Once a client has asked for more distinct things than fit, the rest are simply answered
+            if (state.count < KEYS_PER_CLIENT)
+                state.keys[state.count++] = key;
+            return true;
+        }
+
+        /**
+         * Forgets a client mid-tick, used when its table entry is handed to someone else
+         */
+        void remove(size_t client) {
+            // Stays listed as touched, so it's still cleared with the rest next tick
+            m_states[client].count = 0;
+        }
+
+        [[nodiscard]] const coalesce_stats& stats() const {
+            return m_stats;
+        }
+    };
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "server_socket.h"
+#include "shared_datagram.hpp"
+
+namespace net {
+    // A CONTROLLER_DATA datagram is 100 bytes, a full MOTION_BATCH_DATA datagram 229
+    constexpr size_t MAX_DATAGRAM = 256;
+
+    /**
+     * Fixed ring of encoded datagrams, when full the oldest entry makes room for the newest.
+     * An entry either holds its own copy of the datagram or points at a shared_datagram.
+     * @tparam Depth number of datagrams held
+     */
+    template <size_t Depth>
+    class datagram_ring {
+        std::array<std::array<uint8_t, MAX_DATAGRAM>, Depth> m_buffers{};
+        std::array<uint16_t, Depth> m_lengths{};
+        std::array<shared_datagram, Depth> m_shared{};
+        uint32_t m_head = 0;
+        uint32_t m_tail = 0;
+    public:
+        /**
+         * Reserves the buffer for the next datagram, call commit once it has been written
+         * @param outDropped set when the oldest datagram had to be dropped to make room
+         * @return the buffer to encode into
+         */
+        std::span<uint8_t, MAX_DATAGRAM> reserve(bool& outDropped) {
+            outDropped = size() == Depth;
+            if (outDropped)
+                pop();
+            return m_buffers[m_head % Depth];
+        }
+
+        void commit(uint16_t length) {
+            m_lengths[m_head % Depth] = length;
+            ++m_head;
+        }
+
+        /**
+         * Queues a datagram without copying it, the ring releases it once it is popped
+         * @param datagram a datagram whose users count already includes this entry
+         * @param outDropped set when the oldest datagram had to be dropped to make room
+         */
+        void push(const shared_datagram& datagram, bool& outDropped) {
+            outDropped = size() == Depth;
+            if (outDropped)
+                pop();
+            m_shared[m_head % Depth] = datagram;
+            m_lengths[m_head % Depth] = static_cast<uint16_t>(datagram.data.size());
+            ++m_head;
+        }
+
+        /**
+         * @return the datagram at a position from the front, for building batches without consuming them
+         */
+        [[nodiscard]] sockets::outgoing_datagram at(size_t position, const sockets::endpoint& remote_ep) const {
+            const auto index = (m_tail + position) % Depth;
+            const auto* const data = m_shared[index].data.empty() ? m_buffers[index].data() : m_shared[index].data.data();
+            return {data, m_lengths[index], &remote_ep};
+        }
+
+        void pop() {
+            auto& shared = m_shared[m_tail++ % Depth];
+            shared.release();
+            shared = shared_datagram{};
+        }
+
+        void clear() {
+            while (size() != 0)
+                pop();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return m_head - m_tail;
+        }
+    };
+
+    struct queue_stats {
+        // Data superseded by a newer sample before it could be sent
+        uint32_t dropped_stale = 0;
+        // Control replies dropped because the client had too many outstanding
+        uint32_t dropped_control = 0;
+        // Datagrams the network stack refused outright
+        uint32_t send_errors = 0;
+    };
+
+    struct client_queue {
+        // Enough for a CONTROLLER_INFO reply covering all four slots
+        datagram_ring<4> control;
+        // Only the newest sample matters, a new one overwrites a sample still waiting in place and counts it as stale
+        datagram_ring<1> data;
+        queue_stats stats;
+    };
+
+    enum class datagram_kind {
+        CONTROL,
+        DATA
+    };
+
+    /**
+     * Bounded queues of encoded datagrams between encoding and transmission, one per client.
+     * Every client's control replies go before any client's data, so a socket that stops taking datagrams partway
+     * leaves data behind rather than replies. Each flush starts from a different client, so a client the stack keeps
+     * refusing can't hold up the others.
+     * @tparam Capacity the capacity of the client table, queues are indexed the same way
+     */
+    template <size_t Capacity>
+    class send_queues {
+        struct batch_entry {
+            uint32_t client;
+            datagram_kind kind;
+        };
+
+        std::array<client_queue, Capacity> m_queues{};
+        std::array<sockets::endpoint, Capacity> m_endpoints{};
+        // The registry generation each queue was last reset for
+        std::array<uint16_t, Capacity> m_generations{};
+        // One past the highest client index in use
+        uint32_t m_limit = 0;
+        std::array<sockets::outgoing_datagram, Capacity * 6> m_batch{};
+        std::array<batch_entry, Capacity * 6> m_entries{};
+        uint32_t m_first = 0;
+    public:
+        /**
+         * Reserves a buffer for a datagram to a client, call commit once it has been written
+         * @param client the client table index
+         * @param kind control replies and data are queued separately
+         * @return the buffer to encode into
+         */
+        std::span<uint8_t, MAX_DATAGRAM> reserve(size_t client, datagram_kind kind) {
+            auto& queue = m_queues[client];
+            bool dropped;
+            if (kind == datagram_kind::CONTROL) {
+                const auto buffer = queue.control.reserve(dropped);
+                queue.stats.dropped_control += dropped;
+                return buffer;
+            }
+            const auto buffer = queue.data.reserve(dropped);
+            queue.stats.dropped_stale += dropped;
+            return buffer;
+        }
+
+        void commit(size_t client, datagram_kind kind, uint16_t length) {
+            auto& queue = m_queues[client];
+            if (kind == datagram_kind::CONTROL)
+                queue.control.commit(length);
+            else
+                queue.data.commit(length);
+        }
+
+        /**
+         * Queues a control reply that is sent from where it is instead of being copied
+         * @param client the client table index
+         * @param reply the reply, released once it is sent or dropped
+         */
+        void push_control(size_t client, const shared_datagram& reply) {
+            auto& queue = m_queues[client];
+            bool dropped;
+            queue.control.push(reply, dropped);
+            queue.stats.dropped_control += dropped;
+        }
+
+        /**
+         * Records where a client's datagrams go, call before reserving for it
+         * @param client the client table index
+         * @param remote_ep the client's endpoint
+         */
+        void set_endpoint(size_t client, const sockets::endpoint& remote_ep) {
+            m_endpoints[client] = remote_ep;
+            m_limit = std::max(m_limit, static_cast<uint32_t>(client + 1));
+        }
+
+        /**
+         * Forgets everything queued for a client, used when its table entry is handed to someone else
+         * @param client the client table index
+         * @param generation the registry generation of the new owner
+         */
+        void reset(size_t client, uint16_t generation) {
+            // Shared replies still queued have to be released before the entries are forgotten
+            m_queues[client].control.clear();
+            m_queues[client] = client_queue{};
+            m_generations[client] = generation;
+        }
+
+        /**
+         * Places a datagram's registry generation relative to the queue's, generations wrap so only the difference counts
+         * @return below 0 for a datagram meant for an earlier owner of the entry, above 0 for one meant for an owner the queue
+         * hasn't been reset for yet
+         */
+        [[nodiscard]] int16_t compare_generation(size_t client, uint16_t generation) const {
+            return static_cast<int16_t>(generation - m_generations[client]);
+        }
+
+        [[nodiscard]] const queue_stats& stats(size_t client) const {
+            return m_queues[client].stats;
+        }
+
+        /**
+         * Sends as much as the socket takes without blocking
+         * @param socket the socket to send from, anything with udp_socket's send_batch
+         * @return the number of datagrams sent
+         */
+        template <typename Socket = sockets::server_socket>
+        size_t flush(Socket& socket) {
+            size_t count = 0;
+            const auto clientCount = m_limit;
+            const auto gather = [&](uint32_t client, const auto& ring, datagram_kind kind) {
+                for (size_t position = 0; position < ring.size(); ++position) {
+                    m_batch[count] = ring.at(position, m_endpoints[client]);
+                    m_entries[count++] = {client, kind};
+                }
+            };
+            for (size_t i = 0; i < clientCount; ++i) {
+                const auto client = static_cast<uint32_t>((m_first + i) % clientCount);
+                gather(client, m_queues[client].control, datagram_kind::CONTROL);
+            }
+            for (size_t i = 0; i < clientCount; ++i) {
+                const auto client = static_cast<uint32_t>((m_first + i) % clientCount);
+                gather(client, m_queues[client].data, datagram_kind::DATA);
+            }
+            if (clientCount != 0)
+                m_first = (m_first + 1) % clientCount;
+
+            size_t done = 0;
+            size_t sent = 0;
+            while (done < count) {
+                ssize_t result;
+                try {
+                    result = socket.send_batch({m_batch.data() + done, count - done}, sockets::msg_flags::DONT_WAIT);
+                }
+                catch (const utils::errno_error&) {
+                    // Only the first datagram of the remainder can have failed, drop it and carry on with the rest
+                    m_queues[m_entries[done].client].stats.send_errors++;
+                    pop(m_entries[done++]);
+                    continue;
+                }
+                if (result <= 0)
+                    break;
+                for (ssize_t i = 0; i < result; ++i)
+                    pop(m_entries[done++]);
+                sent += result;
+            }
+            return sent;
+        }
+
+    private:
+        void pop(const batch_entry& entry) {
+            auto& queue = m_queues[entry.client];
+            if (entry.kind == datagram_kind::CONTROL)
+                queue.control.pop();
+            else
+                queue.data.pop();
+        }
+    };
+}
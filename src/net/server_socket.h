@@ -0,0 +1,16 @@
+#pragma once
+
+// The socket type the server runs on, picked at build time
+#ifdef DSU_IO_URING
+#include "uring_socket.h"
+
+namespace sockets {
+    using server_socket = uring_socket;
+}
+#else
+#include "udp_socket.h"
+
+namespace sockets {
+    using server_socket = udp_socket;
+}
+#endif
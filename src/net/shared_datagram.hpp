@@ -0,0 +1,22 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+namespace net {
+    /**
+     * A datagram that stays where its owner encoded it, such as a cached reply, and is sent from there.
+     * users counts the queue entries pointing at it, the owner only rewrites it once that is back to 0.
+     */
+    struct shared_datagram {
+        std::span<const uint8_t> data{};
+        // Null for a datagram that never changes
+        std::atomic<uint32_t>* users = nullptr;
+
+        void release() const {
+            if (users != nullptr)
+                users->fetch_sub(1, std::memory_order_release);
+        }
+    };
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Shared between the server and the processes reading from it, so this header only depends on the standard library and Linux
+namespace net::shm {
+    constexpr uint32_t MAGIC = 0x4D555344; // "DSUM"
+    constexpr uint32_t VERSION = 1;
+    constexpr const char* DEFAULT_NAME = "/dsu_controller";
+
+    constexpr size_t SLOTS = 4;
+    // Every DSU datagram fits
+    constexpr size_t MAX_DATAGRAM = 256;
+    // Motion samples kept for readers that fell behind, a power of two
+    constexpr size_t HISTORY = 256;
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+                  "the region is shared between processes, its atomics can't hide behind a lock");
+
+    /**
+     * One motion sample in host order, the same values a MOTION_BATCH_DATA datagram carries
+     */
+    struct sample_record {
+        uint64_t timestamp_usec = 0;
+        float accelerometer[3]{};
+        // Pitch, yaw, roll
+        float gyroscope[3]{};
+    };
+
+    /**
+     * The newest CONTROLLER_DATA datagram for a slot, exactly as it would have been sent, so readers reuse their DSU parsing
+     */
+    struct alignas(64) slot_snapshot {
+        // Odd while the writer is inside, bumped by two per datagram
+        std::atomic<uint32_t> sequence{0};
+        uint16_t length = 0;
+        std::array<uint8_t, MAX_DATAGRAM> datagram{};
+    };
+
+    struct history_entry {
+        // Index + 1 of the sample stored here, zero while it's being written
+        std::atomic<uint64_t> sequence{0};
+        sample_record sample{};
+    };
+
+    /**
+     * Everything in the shared memory object. Written by the server only, readers never take a lock or make a system call
+     * unless they choose to sleep on the doorbell.
+     */
+    struct region {
+        // Written last, a reader that sees MAGIC sees an initialised region
+        std::atomic<uint32_t> magic{0};
+        uint32_t version = VERSION;
+        uint32_t slots = SLOTS;
+        uint32_t history = HISTORY;
+
+        // Bumped once per sample, after the snapshots and history have been updated
+        alignas(64) std::atomic<uint32_t> doorbell{0};
+        // Readers sleeping on the doorbell, the writer only makes the wake call when there are any
+        std::atomic<uint32_t> sleepers{0};
+        // Motion samples written so far
+        alignas(64) std::atomic<uint64_t> samples{0};
+        // CLOCK_MONOTONIC nanoseconds of the last time any reader looked, the server keeps sampling at full rate while this is recent
+        alignas(64) std::atomic<int64_t> last_read{0};
+
+        std::array<slot_snapshot, SLOTS> snapshots{};
+        std::array<history_entry, HISTORY> entries{};
+    };
+
+    inline int64_t monotonic_now() {
+        timespec time{};
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+
+    /**
+     * Waits on a futex word in shared memory, the mapping may be shared between processes
+     * @return false if the timeout passed first
+     */
+    inline bool futex_wait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout) {
+        const timespec time{static_cast<time_t>(timeout.count() / 1000000000), static_cast<long>(timeout.count() % 1000000000)};
+        const auto result = ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &time, nullptr, 0);
+        return result == 0 || errno != ETIMEDOUT;
+    }
+
+    inline void futex_wake(std::atomic<uint32_t>& word) {
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+    }
+
+    /**
+     * Copies a snapshot out under its sequence lock, retrying while the writer is inside
+     * @return the snapshot's sequence, the copy is consistent with it
+     */
+    inline uint32_t read_snapshot(const slot_snapshot& snapshot, std::array<uint8_t, MAX_DATAGRAM>& outDatagram, uint16_t& outLength) {
+        while (true) {
+            const auto before = snapshot.sequence.load(std::memory_order_acquire);
+            if ((before & 1) != 0)
+                continue;
+            outLength = snapshot.length;
+            std::memcpy(outDatagram.data(), snapshot.datagram.data(), std::min<size_t>(outLength, MAX_DATAGRAM));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (snapshot.sequence.load(std::memory_order_relaxed) == before)
+                return before;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifdef DSU_SHARED_MEMORY
+#ifndef __linux__
+#error "DSU_SHARED_MEMORY is only supported on Linux hosts"
+#endif
+#include "shm_publisher.h"
+#include "../utils/exception.hpp"
+
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+namespace net::shm {
+    publisher::publisher(const char* name) : m_name(name) {
+        const auto fd = ::shm_open(name, O_CREAT | O_RDWR, 0600);
+        if (fd < 0)
+            throw utils::errno_error();
+        // Truncating first zeroes whatever an earlier run left behind, a reader still mapping it sees the magic disappear
+        if (::ftruncate(fd, 0) < 0 || ::ftruncate(fd, sizeof(region)) < 0) {
+            const auto error = errno;
+            ::close(fd);
+            throw utils::errno_error(error);
+        }
+        auto* const mapping = ::mmap(nullptr, sizeof(region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        const auto error = errno;
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+            throw utils::errno_error(error);
+
+        m_region = new (mapping) region{};
+        m_region->magic.store(MAGIC, std::memory_order_release);
+    }
+
+    publisher::~publisher() {
+        m_region->magic.store(0, std::memory_order_relaxed);
+        ::munmap(m_region, sizeof(region));
+        ::shm_unlink(m_name);
+    }
+
+    std::span<uint8_t, MAX_DATAGRAM> publisher::begin_snapshot(uint8_t slot) {
+        auto& snapshot = m_region->snapshots[slot % SLOTS];
+        snapshot.sequence.store(snapshot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return snapshot.datagram;
+    }
+
+    void publisher::commit_snapshot(uint8_t slot, uint16_t length) {
+        auto& snapshot = m_region->snapshots[slot % SLOTS];
+        snapshot.length = length;
+        snapshot.sequence.store(snapshot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void publisher::publish_sample(const sample_record& sample) {
+        const auto index = m_region->samples.load(std::memory_order_relaxed);
+        auto& entry = m_region->entries[index % HISTORY];
+        entry.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        entry.sample = sample;
+        entry.sequence.store(index + 1, std::memory_order_release);
+        m_region->samples.store(index + 1, std::memory_order_release);
+    }
+
+    void publisher::ring() {
+        m_region->doorbell.fetch_add(1, std::memory_order_seq_cst);
+        if (m_region->sleepers.load(std::memory_order_seq_cst) != 0)
+            futex_wake(m_region->doorbell);
+    }
+
+    bool publisher::active(std::chrono::nanoseconds timeout) const {
+        const auto lastRead = m_region->last_read.load(std::memory_order_relaxed);
+        return lastRead != 0 && monotonic_now() - lastRead < timeout.count();
+    }
+}
+#endif
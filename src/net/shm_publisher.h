@@ -0,0 +1,52 @@
+#pragma once
+
+#ifdef DSU_SHARED_MEMORY
+
+#include <chrono>
+#include <span>
+
+#include "shm_layout.hpp"
+
+namespace net::shm {
+    /**
+     * Server side of the shared memory transport, creates the object on construction and removes it on destruction.
+     * Meant for a single writing thread. Snapshots are encoded in place under their sequence lock, and the doorbell
+     * only makes a system call when a reader is asleep on it.
+     */
+    class publisher {
+        region* m_region = nullptr;
+        const char* m_name;
+    public:
+        /**
+         * @param name the shared memory object to create, replacing one left behind by an earlier run
+         * @throws utils::errno_error if it can't be created or mapped
+         */
+        explicit publisher(const char* name = DEFAULT_NAME);
+        ~publisher();
+
+        publisher(const publisher&) = delete;
+        publisher& operator=(const publisher&) = delete;
+
+        /**
+         * Opens a slot's snapshot for writing, readers retry until commit_snapshot
+         * @return the buffer to encode the datagram into
+         */
+        std::span<uint8_t, MAX_DATAGRAM> begin_snapshot(uint8_t slot);
+
+        void commit_snapshot(uint8_t slot, uint16_t length);
+
+        void publish_sample(const sample_record& sample);
+
+        /**
+         * Tells readers a new sample is out, call once the snapshots and history have been updated
+         */
+        void ring();
+
+        /**
+         * @return whether a reader has looked at the region within the timeout
+         */
+        [[nodiscard]] bool active(std::chrono::nanoseconds timeout) const;
+    };
+}
+
+#endif
@@ -0,0 +1,157 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm_layout.hpp"
+
+namespace net::shm {
+    /**
+     * Reads controller data a DSU server on the same machine publishes into shared memory, meant to be dropped into the consuming
+     * process along with shm_layout.hpp. Nothing on the read path makes a system call, wait only does when there's nothing new.
+     * Reading counts as interest, the server keeps sampling at full rate while some reader has looked within the last 5 seconds.
+     */
+    class reader {
+        // How stale last_read may get before a read refreshes it, well within the server's 5 seconds, so readers polling
+        // every frame don't keep pulling its cache line away from each other
+        static constexpr int64_t TOUCH_INTERVAL = 1000000000;
+
+        region* m_region = nullptr;
+        uint64_t m_cursor = 0;
+        uint32_t m_doorbell = 0;
+        uint64_t m_lost = 0;
+    public:
+        /**
+         * @param name the shared memory object the server publishes to
+         * @throws std::system_error if there's no such object, std::runtime_error if it isn't one this reader understands
+         */
+        explicit reader(const char* name = DEFAULT_NAME) {
+            const auto fd = ::shm_open(name, O_RDWR, 0);
+            if (fd < 0)
+                throw std::system_error(errno, std::generic_category(), "shm_open");
+            struct stat info{};
+            if (::fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < sizeof(region)) {
+                ::close(fd);
+                throw std::runtime_error("shared memory object is smaller than the region this reader expects");
+            }
+            auto* const mapping = ::mmap(nullptr, sizeof(region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            const auto error = errno;
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+                throw std::system_error(error, std::generic_category(), "mmap");
+
+            m_region = static_cast<region*>(mapping);
+            if (m_region->magic.load(std::memory_order_acquire) != MAGIC || m_region->version != VERSION) {
+                ::munmap(mapping, sizeof(region));
+                m_region = nullptr;
+                throw std::runtime_error("shared memory object wasn't created by a compatible server");
+            }
+            // Only samples from now on, latest gives the current state
+            m_cursor = m_region->samples.load(std::memory_order_acquire);
+            m_doorbell = m_region->doorbell.load(std::memory_order_acquire);
+            touch();
+        }
+
+        reader(reader&& other) noexcept
+        : m_region(std::exchange(other.m_region, nullptr)), m_cursor(other.m_cursor), m_doorbell(other.m_doorbell), m_lost(other.m_lost) {}
+
+        reader& operator=(reader&& other) noexcept {
+            std::swap(m_region, other.m_region);
+            std::swap(m_cursor, other.m_cursor);
+            std::swap(m_doorbell, other.m_doorbell);
+            std::swap(m_lost, other.m_lost);
+            return *this;
+        }
+
+        ~reader() {
+            if (m_region != nullptr)
+                ::munmap(m_region, sizeof(region));
+        }
+
+        /**
+         * @param slot the controller slot, below SLOTS
+         * @param outDatagram receives the newest CONTROLLER_DATA datagram of the slot
+         * @return the length of the datagram, 0 if the slot hasn't published anything
+         */
+        uint16_t latest(uint8_t slot, std::array<uint8_t, MAX_DATAGRAM>& outDatagram) {
+            touch();
+            uint16_t length = 0;
+            read_snapshot(m_region->snapshots[slot % SLOTS], outDatagram, length);
+            return length;
+        }
+
+        /**
+         * Copies the motion samples published since the last call, oldest first
+         * @param out filled from the front, anything that doesn't fit is returned by the next call
+         * @return the number of samples copied
+         */
+        size_t read_samples(std::span<sample_record> out) {
+            touch();
+            const auto written = m_region->samples.load(std::memory_order_acquire);
+            if (written - m_cursor > HISTORY) {
+                m_lost += written - m_cursor - HISTORY;
+                m_cursor = written - HISTORY;
+            }
+            size_t count = 0;
+            while (m_cursor < written && count < out.size()) {
+                const auto& entry = m_region->entries[m_cursor % HISTORY];
+                const auto before = entry.sequence.load(std::memory_order_acquire);
+                const auto sample = entry.sample;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                // The server lapped this reader while it was copying
+                if (before == m_cursor + 1 && entry.sequence.load(std::memory_order_relaxed) == before)
+                    out[count++] = sample;
+                else
+                    ++m_lost;
+                ++m_cursor;
+            }
+            return count;
+        }
+
+        /**
+         * Sleeps until the server publishes another sample, returns straight away if it has since the last call
+         * @param timeout the longest to sleep
+         * @return false if the timeout passed first, may also return early without a new sample
+         */
+        bool wait(std::chrono::nanoseconds timeout) {
+            touch();
+            auto current = m_region->doorbell.load(std::memory_order_acquire);
+            if (current == m_doorbell) {
+                m_region->sleepers.fetch_add(1, std::memory_order_seq_cst);
+                // The server may have rung between the first look and registering as a sleeper
+                current = m_region->doorbell.load(std::memory_order_seq_cst);
+                const auto rang = current != m_doorbell || futex_wait(m_region->doorbell, m_doorbell, timeout);
+                m_region->sleepers.fetch_sub(1, std::memory_order_relaxed);
+                if (!rang)
+                    return false;
+                current = m_region->doorbell.load(std::memory_order_acquire);
+            }
+            m_doorbell = current;
+            return true;
+        }
+
+        /**
+         * @return the samples that were overwritten before this reader got to them
+         */
+        [[nodiscard]] uint64_t lost() const {
+            return m_lost;
+        }
+
+    private:
+        void touch() {
+            const auto now = monotonic_now();
+            if (now - m_region->last_read.load(std::memory_order_relaxed) >= TOUCH_INTERVAL)
+                m_region->last_read.store(now, std::memory_order_relaxed);
+        }
+    };
+}
+
+#endif
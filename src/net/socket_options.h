@@ -0,0 +1,99 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#if __has_include(<netinet/udp.h>)
+#include <netinet/udp.h>
+#endif
+#if __has_include(<linux/filter.h>)
+#include <linux/filter.h>
+#endif
+#include <cstdint>
+
+namespace sockets {
+    /**
+     * Protocol level an option is applied at, the level argument of setsockopt/getsockopt
+     */
+    enum class option_level {
+        SOCKET = SOL_SOCKET,
+        IP = IPPROTO_IP,
+        UDP = IPPROTO_UDP
+    };
+
+    /**
+     * Describes a single socket option, binding its level and name to the type of value it takes
+     * @tparam Level the protocol level of the option
+     * @tparam Name the option name at that level
+     * @tparam Value the type of the option value, void for options that take no value
+     */
+    template <option_level Level, int Name, typename Value>
+    struct socket_option {
+        using value_type = Value;
+        static constexpr option_level level = Level;
+        static constexpr int name = Name;
+    };
+
+    namespace options {
+        using reuse_address = socket_option<option_level::SOCKET, SO_REUSEADDR, int>;
+        using broadcast = socket_option<option_level::SOCKET, SO_BROADCAST, int>;
+        using send_buffer_size = socket_option<option_level::SOCKET, SO_SNDBUF, int>;
+        using receive_buffer_size = socket_option<option_level::SOCKET, SO_RCVBUF, int>;
+        using send_low_at = socket_option<option_level::SOCKET, SO_SNDLOWAT, int>;
+        using receive_low_at = socket_option<option_level::SOCKET, SO_RCVLOWAT, int>;
+        using type = socket_option<option_level::SOCKET, SO_TYPE, int>;
+        using error = socket_option<option_level::SOCKET, SO_ERROR, int>;
+#ifdef SO_PRIORITY
+        // Linux only, selects the 802.1d priority (and so the WMM access category) of outgoing frames
+        using priority = socket_option<option_level::SOCKET, SO_PRIORITY, int>;
+#endif
+#ifdef SO_REUSEPORT
+        using reuse_port = socket_option<option_level::SOCKET, SO_REUSEPORT, int>;
+#endif
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+        // Linux only, picks which socket of a SO_REUSEPORT group receives each datagram
+        using attach_reuseport_cbpf = socket_option<option_level::SOCKET, SO_ATTACH_REUSEPORT_CBPF, sock_fprog>;
+#endif
+#ifdef SO_RXDATA
+        // nsysnet only
+        using rx_data = socket_option<option_level::SOCKET, SO_RXDATA, int>;
+        using tx_data = socket_option<option_level::SOCKET, SO_TXDATA, int>;
+        using non_block = socket_option<option_level::SOCKET, SO_NONBLOCK, int>;
+        using set_non_blocking = socket_option<option_level::SOCKET, SO_NBIO, void>;
+        using set_blocking_io = socket_option<option_level::SOCKET, SO_BIO, void>;
+#endif
+
+#ifdef IP_TOS
+        using type_of_service = socket_option<option_level::IP, IP_TOS, int>;
+#endif
+#ifdef IP_TTL
+        using time_to_live = socket_option<option_level::IP, IP_TTL, int>;
+#endif
+#ifdef IP_MULTICAST_TTL
+        using multicast_ttl = socket_option<option_level::IP, IP_MULTICAST_TTL, uint8_t>;
+#endif
+#ifdef IP_MULTICAST_LOOP
+        using multicast_loop = socket_option<option_level::IP, IP_MULTICAST_LOOP, uint8_t>;
+#endif
+
+#ifdef UDP_SEGMENT
+        // Linux only, generic segmentation offload size for a single send
+        using segment_size = socket_option<option_level::UDP, UDP_SEGMENT, int>;
+#endif
+    }
+
+    /**
+     * Differentiated services code points, see RFC 4594
+     */
+    enum class dscp : uint8_t {
+        BEST_EFFORT = 0,
+        CS5 = 40,
+        EXPEDITED_FORWARDING = 46
+    };
+
+    /**
+     * @return the IP type of service byte for a code point, the DSCP takes the upper six bits
+     */
+    constexpr int tos_from_dscp(dscp codePoint) {
+        return static_cast<int>(codePoint) << 2;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "udp_socket.h"
+
+namespace sockets {
+    /**
+     * A set of socket options applied together at startup
+     */
+    struct socket_profile {
+        dscp code_point = dscp::BEST_EFFORT;
+        // 0 leaves the system default in place
+        int send_buffer_size = 0;
+        int receive_buffer_size = 0;
+    };
+
+    /**
+     * Marks traffic as EF so that WMM maps it to the voice access category on APs that honour DSCP,
+     * and keeps the buffers small enough that a stale sample can't sit queued behind many others.
+     * A CONTROLLER_DATA reply is 100 bytes, so these hold a few ticks for a handful of clients.
+     */
+    constexpr socket_profile low_latency_profile{
+        .code_point = dscp::EXPEDITED_FORWARDING,
+        .send_buffer_size = 16 * 1024,
+        .receive_buffer_size = 8 * 1024
+    };
+
+    /**
+     * The values actually in effect after applying a profile, -1 where the stack doesn't support the option
+     */
+    struct applied_profile {
+        int type_of_service = -1;
+        int send_buffer_size = -1;
+        int receive_buffer_size = -1;
+    };
+
+    /**
+     * Applies every option in the profile that the network stack supports.
+     * Options the stack rejects are skipped rather than treated as fatal since none of them are needed for correctness.
+     * @param socket the socket to configure
+     * @param profile the options to apply
+     * @return the values read back from the socket
+     */
+    inline applied_profile apply_profile(udp_socket& socket, const socket_profile& profile) {
+        applied_profile applied;
+#ifdef IP_TOS
+        try {
+            socket.set_option<options::type_of_service>(tos_from_dscp(profile.code_point));
+            applied.type_of_service = socket.get_option<options::type_of_service>();
+        }
+        catch (const utils::errno_error&) {}
+#endif
+#ifdef SO_PRIORITY
+        try {
+            // 802.1d priority 6 lands in the WMM voice access category
+            if (profile.code_point != dscp::BEST_EFFORT)
+                socket.set_option<options::priority>(6);
+        }
+        catch (const utils::errno_error&) {}
+#endif
+        try {
+            if (profile.send_buffer_size > 0)
+                socket.set_option<options::send_buffer_size>(profile.send_buffer_size);
+            applied.send_buffer_size = socket.get_option<options::send_buffer_size>();
+        }
+        catch (const utils::errno_error&) {}
+        try {
+            if (profile.receive_buffer_size > 0)
+                socket.set_option<options::receive_buffer_size>(profile.receive_buffer_size);
+            applied.receive_buffer_size = socket.get_option<options::receive_buffer_size>();
+        }
+        catch (const utils::errno_error&) {}
+        return applied;
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+
+#include "../dsu/DsuPacket.hpp"
+
+namespace net {
+    constexpr size_t MAX_SLOTS = 4;
+
+    /**
+     * CONTROLLER_DATA registrations of every client, kept as a bitset of clients per slot.
+     * Clients are identified by their index in the client table.
+     * @tparam Capacity the capacity of the client table, the default fills one word of clients per slot
+     */
+    template <size_t Capacity = 32>
+    class subscription_index {
+        using clock = std::chrono::steady_clock;
+        // Plain words rather than std::bitset so set bits can be walked with countr_zero
+        using client_set = std::array<uint32_t, (Capacity + 31) / 32>;
+
+        std::array<client_set, MAX_SLOTS> m_subscribers{};
+        std::array<std::array<clock::time_point, MAX_SLOTS>, Capacity> m_expiry{};
+        std::array<DSU::MacAddress, MAX_SLOTS> m_slot_macs{};
+        std::bitset<MAX_SLOTS> m_mac_known{};
+    public:
+        // DSU clients re-send their registration well within this, and stop receiving data once it lapses
+        static constexpr auto TIMEOUT = std::chrono::seconds(5);
+
+        /**
+         * Records which controller is in a slot so MAC based registrations can be resolved
+         */
+        void set_slot_mac(uint8_t slot, const DSU::MacAddress& mac) {
+            m_slot_macs[slot] = mac;
+            m_mac_known.set(slot);
+        }
+
+        /**
+         * Adds or refreshes the registrations in a CONTROLLER_DATA request
+         * @param client the index of the requesting client
+         * @param request the parsed request
+         * @param now the time the request was received
+         */
+        void subscribe(size_t client, const DSU::Packets::Incoming::ControllerData& request, clock::time_point now) {
+            using DSU::RegistrationType;
+            const auto expiry = now + TIMEOUT;
+            if (request.registration_type == RegistrationType::SUBSCRIBE_ALL) {
+                for (size_t slot = 0; slot < MAX_SLOTS; ++slot)
+                    add(client, slot, expiry);
+                return;
+            }
+            if ((request.registration_type & RegistrationType::SLOT_BASED) == RegistrationType::SLOT_BASED && request.reporting_slot < MAX_SLOTS)
+                add(client, request.reporting_slot, expiry);
+            if ((request.registration_type & RegistrationType::MAC_BASED) == RegistrationType::MAC_BASED) {
+                for (size_t slot = 0; slot < MAX_SLOTS; ++slot) {
+                    if (m_mac_known.test(slot) && m_slot_macs[slot] == request.mac_address)
+                        add(client, slot, expiry);
+                }
+            }
+        }
+
+        /**
+         * Drops every registration of a client, used when its table entry is handed to someone else
+         */
+        void remove(size_t client) {
+            for (auto& subscribers : m_subscribers)
+                subscribers[client / 32] &= ~(1u << (client % 32));
+        }
+
+        /**
+         * @return whether any client is registered for the slot
+         */
+        [[nodiscard]] bool any(uint8_t slot) const {
+            for (const auto word : m_subscribers[slot]) {
+                if (word != 0)
+                    return true;
+            }
+            return false;
+        }
+
+        /**
+         * @return whether any client is registered for any slot
+         */
+        [[nodiscard]] bool any() const {
+            for (uint8_t slot = 0; slot < MAX_SLOTS; ++slot) {
+                if (any(slot))
+                    return true;
+            }
+            return false;
+        }
+
+        /**
+         * Drops every registration that has lapsed
+         * @param now the current time
+         * @return whether anything was dropped
+         */
+        bool expire(clock::time_point now) {
+            bool dropped = false;
+            for (size_t slot = 0; slot < MAX_SLOTS; ++slot) {
+                auto& subscribers = m_subscribers[slot];
+                for (size_t word = 0; word < subscribers.size(); ++word) {
+                    for (auto bits = subscribers[word]; bits != 0; bits &= bits - 1) {
+                        const size_t client = word * 32 + std::countr_zero(bits);
+                        if (m_expiry[client][slot] <= now) {
+                            subscribers[word] &= ~(1u << (client % 32));
+                            dropped = true;
+                        }
+                    }
+                }
+            }
+            return dropped;
+        }
+
+        /**
+         * @return the slots a client is registered for, bit n set for slot n
+         */
+        [[nodiscard]] uint8_t slot_mask(size_t client) const {
+            uint8_t mask = 0;
+            for (size_t slot = 0; slot < MAX_SLOTS; ++slot) {
+                if (m_subscribers[slot][client / 32] & (1u << (client % 32)))
+                    mask |= 1u << slot;
+            }
+            return mask;
+        }
+
+        /**
+         * @return when a client's registration for a slot lapses, meaningless unless it's registered
+         */
+        [[nodiscard]] clock::time_point expiry(size_t client, size_t slot) const {
+            return m_expiry[client][slot];
+        }
+
+    private:
+        void add(size_t client, size_t slot, clock::time_point expiry) {
+            m_subscribers[slot][client / 32] |= 1u << (client % 32);
+            m_expiry[client][slot] = expiry;
+        }
+    };
+}
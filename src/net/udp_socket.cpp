@@ -8,6 +8,11 @@
 #include <cstring>
 
 #include <unistd.h>
+#include <sys/select.h>
+#ifdef __linux__
+#include <array>
+#include <algorithm>
+#endif
 
 
 namespace sockets {
@@ -26,6 +31,16 @@ namespace sockets {
             throw utils::errno_error();
     }
 
+    /**
+     * @return the endpoint the socket is bound to, with the port the system picked if it was bound to port 0
+     */
+    sockets::endpoint udp_socket::local_endpoint() const {
+        sockaddr_storage address{}; socklen_t addressLength = sizeof(address);
+        if (::getsockname(socket_fd, reinterpret_cast<sockaddr*>(&address), &addressLength) < 0)
+            throw utils::errno_error();
+        return sockets::endpoint{address};
+    }
+
     /**
      * @param buffer the buffer to store the received m_data in
      * @param length the capacity of the buffer
@@ -43,6 +58,8 @@ namespace sockets {
                 throw utils::errno_error();
         }
         out_remote_ep = sockets::endpoint{clientAddress};
+        if (m_capture != nullptr)
+            m_capture->record(capture_direction::INBOUND, out_remote_ep, buffer, bytes);
         return bytes;
     }
 
@@ -51,14 +68,97 @@ namespace sockets {
      * @param length the number of bytes to read from the buffer
      * @param flags flags to alter how the send operation behaves
      * @param remote_ep the remote endpoint that the data will be sent to
-     * @returns number of bytes received, or else returns a negative error (see errno) if no m_data is received and the operation is non-blocking
+     * @returns number of bytes sent, or else returns a negative error (see errno) if the send buffer is full and the operation is non-blocking
      * */
     ssize_t udp_socket::send_to(uint8_t *buffer, uint16_t length, sockets::msg_flags flags, const sockets::endpoint& remote_ep) {
         const auto bytes = ::sendto(socket_fd, buffer, length, (int)flags, remote_ep.data(), remote_ep.size());
-        if (bytes < 0)
+        if (bytes < 0){
+            // A full send buffer is routine for a non-blocking socket, so it's reported rather than thrown
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                return -errno;
+            else
+                throw utils::errno_error();
+        }
+        if (m_capture != nullptr)
+            m_capture->record(capture_direction::OUTBOUND, remote_ep, buffer, bytes);
+        return bytes;
+    }
+
+    /**
+     * Sends several datagrams with as few system calls as the platform allows, sendmmsg on Linux and a sendto per datagram elsewhere
+     * @param datagrams the datagrams to send, each with its own destination
+     * @param flags flags to alter how the send operation behaves
+     * @returns number of datagrams sent, stopping at the first one that fails, or else returns a negative error (see errno) if none could be sent and the operation is non-blocking
+     * @throws utils::errno_error if the first datagram fails for any other reason
+     * */
+    ssize_t udp_socket::send_batch(std::span<const outgoing_datagram> datagrams, sockets::msg_flags flags) {
+        size_t sent = 0;
+#ifdef __linux__
+        constexpr size_t MAX_BATCH = 64;
+        std::array<mmsghdr, MAX_BATCH> messages{};
+        std::array<iovec, MAX_BATCH> vectors{};
+        while (sent < datagrams.size()){
+            const auto count = std::min(MAX_BATCH, datagrams.size() - sent);
+            for (size_t i = 0; i < count; ++i){
+                const auto& datagram = datagrams[sent + i];
+                vectors[i] = iovec{const_cast<uint8_t*>(datagram.buffer), datagram.length};
+                messages[i] = mmsghdr{};
+                messages[i].msg_hdr.msg_name = const_cast<sockaddr*>(datagram.remote_ep->data());
+                messages[i].msg_hdr.msg_namelen = datagram.remote_ep->size();
+                messages[i].msg_hdr.msg_iov = &vectors[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            const auto result = ::sendmmsg(socket_fd, messages.data(), count, (int)flags);
+            if (result < 0){
+                if (sent > 0)
+                    break;
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                    return -errno;
+                throw utils::errno_error();
+            }
+            sent += result;
+            if (static_cast<size_t>(result) < count)
+                break;
+        }
+#else
+        for (const auto& datagram : datagrams){
+            const auto bytes = ::sendto(socket_fd, datagram.buffer, datagram.length, (int)flags, datagram.remote_ep->data(), datagram.remote_ep->size());
+            if (bytes < 0){
+                if (sent > 0)
+                    break;
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                    return -errno;
+                throw utils::errno_error();
+            }
+            ++sent;
+        }
+#endif
+        if (m_capture != nullptr) {
+            for (size_t i = 0; i < sent; ++i)
+                m_capture->record(capture_direction::OUTBOUND, *datagrams[i].remote_ep, datagrams[i].buffer, datagrams[i].length);
+        }
+        return static_cast<ssize_t>(sent);
+    }
+
+    /**
+     * Blocks until a datagram is waiting or the timeout passes, for idling without spinning
+     * @param timeout the longest to wait
+     * @returns whether a datagram can be received without blocking
+     * */
+    bool udp_socket::wait_readable(std::chrono::milliseconds timeout){
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(socket_fd, &readable);
+        timeval limit{};
+        limit.tv_sec = static_cast<decltype(limit.tv_sec)>(timeout.count() / 1000);
+        limit.tv_usec = static_cast<decltype(limit.tv_usec)>((timeout.count() % 1000) * 1000);
+        const auto result = ::select(socket_fd + 1, &readable, nullptr, nullptr, &limit);
+        if (result < 0){
+            if (errno == EINTR)
+                return false;
             throw utils::errno_error();
-        else
-            return bytes;
+        }
+        return result > 0;
     }
 
     /**
@@ -77,12 +177,6 @@ namespace sockets {
             throw utils::errno_error();
     }
 
-    void udp_socket::set_option(sockets::option_name name) {
-        const auto result = ::setsockopt(socket_fd, SOL_SOCKET, (int)name, nullptr, 0);
-        if (result < 0)
-            throw utils::errno_error();
-    }
-
     udp_socket::~udp_socket() {
         close();
     }
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <sys/socket.h>
+#include <chrono>
 #include <stdexcept>
+#include <type_traits>
+#include <span>
 
 #include "endpoint.h"
+#include "socket_options.h"
+#include "capture.h"
+#include "../utils/exception.hpp"
 
 namespace sockets {
     enum class msg_flags {
@@ -19,26 +25,6 @@ namespace sockets {
         return static_cast<msg_flags>(static_cast<int>(a) | static_cast<int>(b));
     }
 
-    enum class option_name {
-        REUSE_ADDRESS = SO_REUSEADDR,
-        KEEPALIVE = SO_KEEPALIVE,
-        BROADCAST = SO_BROADCAST,
-        LINGER = SO_LINGER,
-        OUT_OF_BAND_DATA_INLINE = SO_OOBINLINE,
-        TCP_SELECTIVE_ACKNOWLEDGEMENT = SO_TCPSACK,
-        WINDOW_SCALING = SO_WINSCALE,
-        SEND_BUFFER_SIZE = SO_SNDBUF,
-        RECEIVE_BUFFER_SIZE = SO_RCVBUF,
-        SEND_LOW_AT = SO_SNDLOWAT,
-        RECEIVE_LOW_AT = SO_RCVLOWAT,
-        TYPE = SO_TYPE,
-        ERROR = SO_ERROR,
-        RX_DATA = SO_RXDATA,
-        TX_DATA = SO_TXDATA,
-        SET_NON_BLOCKING = SO_NBIO,
-        SET_BLOCKING_IO = SO_BIO,
-        NON_BLOCK = SO_NONBLOCK
-    };
     enum class shutdown_type {
         READ = SHUT_RD,
         WRITE = SHUT_WR,
@@ -46,34 +32,83 @@ namespace sockets {
     };
 
 
+    /**
+     * A datagram ready to go out, the buffer and endpoint must outlive the send
+     */
+    struct outgoing_datagram {
+        const uint8_t* buffer;
+        uint16_t length;
+        const endpoint* remote_ep;
+    };
+
     class udp_socket {
     public:
         udp_socket();
         ~udp_socket();
         void bind(const endpoint&);
+        [[nodiscard]] endpoint local_endpoint() const;
         ssize_t receive_from(uint8_t *buffer, uint16_t length, msg_flags flags, sockets::endpoint &out_remote_ep);
         ssize_t send_to(uint8_t* buffer, uint16_t length, msg_flags flags, const sockets::endpoint &remote_ep);
+        ssize_t send_batch(std::span<const outgoing_datagram> datagrams, msg_flags flags);
+        bool wait_readable(std::chrono::milliseconds timeout);
 
         void close();
         void shutdown(shutdown_type shutdownType);
 
-        void set_option(sockets::option_name name);
+        /**
+         * @return the underlying descriptor, for backends that drive the socket themselves
+         */
+        [[nodiscard]] int native_handle() const {
+            return socket_fd;
+        }
+
+        /**
+         * Copies every datagram received or sent from now on into a capture ring
+         * @param capture the ring to record into, nullptr stops capturing
+         */
+        void set_capture(capture_ring* capture) {
+            m_capture = capture;
+        }
 
 // Compiler doesn't allow split declaration for these
 
-        template <typename Value>
-        void set_option(sockets::option_name name, const Value &value) {
-            const auto result = ::setsockopt(socket_fd, SOL_SOCKET, (int)name, &value, sizeof(value));
+        /**
+         * Sets an option that takes no value
+         * @tparam Option a sockets::socket_option with a void value_type
+         */
+        template <typename Option> requires std::is_void_v<typename Option::value_type>
+        void set_option() {
+            const auto result = ::setsockopt(socket_fd, static_cast<int>(Option::level), Option::name, nullptr, 0);
+            if (result < 0)
+                throw utils::errno_error();
+        }
+
+        /**
+         * @tparam Option a sockets::socket_option describing the level, name and value type
+         * @param value the value to apply
+         */
+        template <typename Option> requires (!std::is_void_v<typename Option::value_type>)
+        void set_option(const typename Option::value_type &value) {
+            const auto result = ::setsockopt(socket_fd, static_cast<int>(Option::level), Option::name, &value, sizeof(value));
             if (result < 0)
-                throw std::runtime_error(std::strerror(errno));
+                throw utils::errno_error();
         }
 
-        template <typename Value>
-        void get_option(sockets::option_name name, Value &outValue) const {
-            const auto result = ::getsockopt(socket_fd, SOL_SOCKET, (int)name, outValue, sizeof(outValue));
+        /**
+         * @tparam Option a sockets::socket_option describing the level, name and value type
+         * @return the value currently in effect, which may differ from what was set (e.g. clamped buffer sizes)
+         */
+        template <typename Option> requires (!std::is_void_v<typename Option::value_type>)
+        [[nodiscard]] typename Option::value_type get_option() const {
+            typename Option::value_type value{};
+            socklen_t length = sizeof(value);
+            const auto result = ::getsockopt(socket_fd, static_cast<int>(Option::level), Option::name, &value, &length);
             if (result < 0)
-                throw std::runtime_error(std::strerror(errno));
+                throw utils::errno_error();
+            return value;
         }
+    protected:
+        capture_ring* m_capture = nullptr;
     private:
         int socket_fd;
     };
@@ -0,0 +1,301 @@
+#ifdef DSU_IO_URING
+#include "uring_socket.h"
+#include "../utils/exception.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace sockets {
+    namespace {
+        // Sends carry their position in the batch, the one receive carries this
+        constexpr uint64_t RECEIVE_TAG = UINT64_MAX;
+        constexpr int BUFFER_GROUP = 0;
+        constexpr unsigned RING_ENTRIES = 128;
+
+        bool is_transient(int error) {
+            return error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS;
+        }
+    }
+
+    uring_socket::uring_socket() {
+        auto result = io_uring_queue_init(RING_ENTRIES, &m_ring, 0);
+        if (result < 0)
+            throw utils::errno_error(-result);
+        m_open = true;
+
+        // Sends get their own ring so a receiving thread and a sending thread never share one
+        result = io_uring_queue_init(RING_ENTRIES, &m_send_ring, 0);
+        if (result < 0) {
+            io_uring_queue_exit(&m_ring);
+            throw utils::errno_error(-result);
+        }
+
+        m_buffer_ring = io_uring_setup_buf_ring(&m_ring, RECEIVE_BUFFERS, BUFFER_GROUP, 0, &result);
+        if (m_buffer_ring == nullptr) {
+            io_uring_queue_exit(&m_send_ring);
+            io_uring_queue_exit(&m_ring);
+            throw utils::errno_error(-result);
+        }
+        for (uint16_t id = 0; id < RECEIVE_BUFFERS; ++id)
+            io_uring_buf_ring_add(m_buffer_ring, m_buffers[id].data(), RECEIVE_BUFFER_SIZE, id, io_uring_buf_ring_mask(RECEIVE_BUFFERS), id);
+        io_uring_buf_ring_advance(m_buffer_ring, RECEIVE_BUFFERS);
+
+        // Lets every request refer to the socket by index instead of looking up the descriptor each time
+        const int descriptor = native_handle();
+        result = io_uring_register_files(&m_ring, &descriptor, 1);
+        if (result >= 0)
+            result = io_uring_register_files(&m_send_ring, &descriptor, 1);
+        if (result < 0) {
+            teardown();
+            throw utils::errno_error(-result);
+        }
+
+        // Multishot receives only look at the name length, the payload lands in the provided buffer
+        m_receive_header.msg_namelen = sizeof(sockaddr_in);
+    }
+
+    /**
+     * @param buffer the buffer to copy the received datagram to
+     * @param length the capacity of the buffer, anything past it is discarded
+     * @param flags only DONT_WAIT is honoured, without it the call waits for a datagram
+     * @param out_remote_ep the remote endpoint that the data has been received from
+     * @returns number of bytes received, or else returns a negative error (see errno) if no m_data is received and the operation is non-blocking
+     * */
+    ssize_t uring_socket::receive_from(uint8_t *buffer, uint16_t length, msg_flags flags, sockets::endpoint &out_remote_ep) {
+        const bool wait = (static_cast<int>(flags) & MSG_DONTWAIT) == 0;
+        while (m_received_head == m_received_tail) {
+            if (!m_receive_armed)
+                arm_receive();
+            io_uring_submit(&m_ring);
+            reap();
+            if (m_received_head != m_received_tail)
+                break;
+            if (!wait)
+                return -EAGAIN;
+            io_uring_cqe* cqe;
+            const auto result = io_uring_wait_cqe(&m_ring, &cqe);
+            if (result < 0 && result != -EINTR)
+                throw utils::errno_error(-result);
+        }
+
+        const auto entry = m_received[m_received_head++ % RECEIVE_BUFFERS];
+        const auto bufferId = static_cast<uint16_t>(entry.flags >> IORING_CQE_BUFFER_SHIFT);
+        auto* const out = io_uring_recvmsg_validate(m_buffers[bufferId].data(), entry.result, &m_receive_header);
+        if (out == nullptr) {
+            recycle(bufferId);
+            return -EAGAIN;
+        }
+        sockaddr_in address{};
+        std::memcpy(&address, io_uring_recvmsg_name(out), std::min<size_t>(out->namelen, sizeof(address)));
+        out_remote_ep = sockets::endpoint{address};
+
+        const auto payloadLength = io_uring_recvmsg_payload_length(out, entry.result, &m_receive_header);
+        const auto copied = std::min<size_t>(payloadLength, length);
+        std::memcpy(buffer, io_uring_recvmsg_payload(out, &m_receive_header), copied);
+        recycle(bufferId);
+        if (m_capture != nullptr)
+            m_capture->record(capture_direction::INBOUND, out_remote_ep, buffer, copied);
+        return static_cast<ssize_t>(copied);
+    }
+
+    /**
+     * @param buffer the buffer to take the received m_data from
+     * @param length the number of bytes to read from the buffer
+     * @param flags flags to alter how the send operation behaves
+     * @param remote_ep the remote endpoint that the data will be sent to
+     * @returns number of bytes sent, or else returns a negative error (see errno) if the send buffer is full and the operation is non-blocking
+     * */
+    ssize_t uring_socket::send_to(uint8_t *buffer, uint16_t length, msg_flags flags, const sockets::endpoint &remote_ep) {
+        const outgoing_datagram datagram{buffer, length, &remote_ep};
+        const auto sent = send_batch({&datagram, 1}, flags);
+        return sent > 0 ? length : sent;
+    }
+
+    /**
+     * Submits the datagrams as linked sendmsg requests, so a failure cancels everything after it and the count stays exact
+     * @param datagrams the datagrams to send, each with its own destination
+     * @param flags flags to alter how the send operation behaves
+     * @returns number of datagrams sent, stopping at the first one that fails, or else returns a negative error (see errno) if none could be sent and the operation is non-blocking
+     * @throws utils::errno_error if the first datagram fails for any other reason
+     * */
+    ssize_t uring_socket::send_batch(std::span<const outgoing_datagram> datagrams, msg_flags flags) {
+        const auto sent = send_chain(datagrams, flags);
+        if (m_capture != nullptr) {
+            for (ssize_t i = 0; i < sent; ++i)
+                m_capture->record(capture_direction::OUTBOUND, *datagrams[i].remote_ep, datagrams[i].buffer, datagrams[i].length);
+        }
+        return sent;
+    }
+
+    /**
+     * Sends in chains of at most MAX_BATCH, stopping at the first chain that doesn't go out whole
+     */
+    ssize_t uring_socket::send_chain(std::span<const outgoing_datagram> datagrams, msg_flags flags) {
+        size_t sent = 0;
+        while (sent < datagrams.size()) {
+            const auto count = std::min(MAX_BATCH, datagrams.size() - sent);
+            for (size_t i = 0; i < count; ++i) {
+                const auto& datagram = datagrams[sent + i];
+                m_send_vectors[i] = iovec{const_cast<uint8_t*>(datagram.buffer), datagram.length};
+                m_send_headers[i] = msghdr{};
+                m_send_headers[i].msg_name = const_cast<sockaddr*>(datagram.remote_ep->data());
+                m_send_headers[i].msg_namelen = datagram.remote_ep->size();
+                m_send_headers[i].msg_iov = &m_send_vectors[i];
+                m_send_headers[i].msg_iovlen = 1;
+                m_send_results[i] = -ECANCELED;
+
+                auto* const sqe = next_sqe(m_send_ring);
+                io_uring_prep_sendmsg(sqe, 0, &m_send_headers[i], static_cast<int>(flags));
+                io_uring_sqe_set_data64(sqe, i);
+                sqe->flags |= IOSQE_FIXED_FILE;
+                if (i + 1 < count)
+                    sqe->flags |= IOSQE_IO_LINK;
+            }
+            m_sends_outstanding = count;
+            io_uring_submit(&m_send_ring);
+            reap_sends();
+            while (m_sends_outstanding > 0) {
+                io_uring_cqe* cqe;
+                const auto result = io_uring_wait_cqe(&m_send_ring, &cqe);
+                if (result < 0 && result != -EINTR)
+                    throw utils::errno_error(-result);
+                reap_sends();
+            }
+
+            const auto failed = std::find_if(m_send_results.begin(), m_send_results.begin() + count, [](int32_t result) { return result < 0; });
+            const auto succeeded = static_cast<size_t>(failed - m_send_results.begin());
+            sent += succeeded;
+            if (succeeded == count)
+                continue;
+            if (sent > 0)
+                break;
+            if (is_transient(-*failed))
+                return *failed;
+            throw utils::errno_error(-*failed);
+        }
+        return static_cast<ssize_t>(sent);
+    }
+
+    /**
+     * Blocks until a datagram is waiting or the timeout passes, for idling without spinning
+     * @param timeout the longest to wait
+     * @returns whether a datagram can be received without blocking
+     * */
+    bool uring_socket::wait_readable(std::chrono::milliseconds timeout) {
+        if (m_received_head != m_received_tail)
+            return true;
+        if (!m_receive_armed)
+            arm_receive();
+        io_uring_submit(&m_ring);
+        reap();
+        if (m_received_head != m_received_tail)
+            return true;
+
+        __kernel_timespec limit{};
+        limit.tv_sec = timeout.count() / 1000;
+        limit.tv_nsec = (timeout.count() % 1000) * 1000000;
+        io_uring_cqe* cqe;
+        const auto result = io_uring_wait_cqe_timeout(&m_ring, &cqe, &limit);
+        if (result < 0 && result != -ETIME && result != -EINTR)
+            throw utils::errno_error(-result);
+        reap();
+        return m_received_head != m_received_tail;
+    }
+
+    /**
+     * Closes the socket and tears down the rings
+     */
+    void uring_socket::close() {
+        if (m_open)
+            teardown();
+        udp_socket::close();
+    }
+
+    void uring_socket::teardown() {
+        io_uring_free_buf_ring(&m_ring, m_buffer_ring, RECEIVE_BUFFERS, BUFFER_GROUP);
+        io_uring_queue_exit(&m_send_ring);
+        io_uring_queue_exit(&m_ring);
+        m_open = false;
+    }
+
+    /**
+     * Queues the multishot receive, it keeps producing completions until the kernel runs out of buffers or hits an error
+     */
+    void uring_socket::arm_receive() {
+        auto* const sqe = next_sqe(m_ring);
+        io_uring_prep_recvmsg_multishot(sqe, 0, &m_receive_header, 0);
+        io_uring_sqe_set_data64(sqe, RECEIVE_TAG);
+        sqe->flags |= IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        m_receive_armed = true;
+    }
+
+    /**
+     * Consumes every receive completion available, received datagrams are queued until read
+     */
+    void uring_socket::reap() {
+        io_uring_cqe* cqe;
+        unsigned head;
+        unsigned seen = 0;
+        io_uring_for_each_cqe(&m_ring, head, cqe) {
+            ++seen;
+            if (io_uring_cqe_get_data64(cqe) != RECEIVE_TAG)
+                continue;
+            if ((cqe->flags & IORING_CQE_F_MORE) == 0)
+                m_receive_armed = false;
+            if ((cqe->flags & IORING_CQE_F_BUFFER) == 0)
+                continue;
+            if (cqe->res < 0) {
+                recycle(static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+                continue;
+            }
+            m_received[m_received_tail++ % RECEIVE_BUFFERS] = {cqe->res, cqe->flags};
+        }
+        io_uring_cq_advance(&m_ring, seen);
+    }
+
+    /**
+     * Consumes every send completion available, results are recorded by position in the batch
+     */
+    void uring_socket::reap_sends() {
+        io_uring_cqe* cqe;
+        unsigned head;
+        unsigned seen = 0;
+        io_uring_for_each_cqe(&m_send_ring, head, cqe) {
+            ++seen;
+            const auto tag = io_uring_cqe_get_data64(cqe);
+            if (tag < MAX_BATCH && m_sends_outstanding > 0) {
+                m_send_results[tag] = cqe->res;
+                --m_sends_outstanding;
+            }
+        }
+        io_uring_cq_advance(&m_send_ring, seen);
+    }
+
+    /**
+     * Hands a provided buffer back to the kernel once its datagram has been copied out
+     */
+    void uring_socket::recycle(uint16_t buffer_id) {
+        io_uring_buf_ring_add(m_buffer_ring, m_buffers[buffer_id].data(), RECEIVE_BUFFER_SIZE, buffer_id, io_uring_buf_ring_mask(RECEIVE_BUFFERS), 0);
+        io_uring_buf_ring_advance(m_buffer_ring, 1);
+    }
+
+    /**
+     * @return a free submission entry, submitting what's queued first if the ring is full
+     */
+    io_uring_sqe* uring_socket::next_sqe(io_uring& ring) {
+        auto* sqe = io_uring_get_sqe(&ring);
+        if (sqe == nullptr) {
+            io_uring_submit(&ring);
+            sqe = io_uring_get_sqe(&ring);
+        }
+        return sqe;
+    }
+
+    uring_socket::~uring_socket() {
+        if (m_open)
+            teardown();
+    }
+}
+#endif
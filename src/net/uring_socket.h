@@ -0,0 +1,68 @@
+#pragma once
+
+#ifdef DSU_IO_URING
+
+#include <array>
+#include <liburing.h>
+
+#include "udp_socket.h"
+
+namespace sockets {
+    /**
+     * A udp_socket whose datagram traffic goes through io_uring, for the Linux host build.
+     * Receives use a single multishot recvmsg drawing from a provided buffer ring,
+     * batches of sends are submitted as one linked chain with a single system call.
+     * Receiving and sending use separate rings, so one thread may receive while another sends.
+     * Options, bind and shutdown are inherited unchanged.
+     */
+    class uring_socket : public udp_socket {
+    public:
+        // Datagrams received but not yet read, also the number of provided receive buffers
+        static constexpr unsigned RECEIVE_BUFFERS = 64;
+        static constexpr unsigned RECEIVE_BUFFER_SIZE = 2048;
+        // Sends submitted per chain, larger batches are split
+        static constexpr size_t MAX_BATCH = 64;
+
+        uring_socket();
+        ~uring_socket();
+        ssize_t receive_from(uint8_t *buffer, uint16_t length, msg_flags flags, sockets::endpoint &out_remote_ep);
+        ssize_t send_to(uint8_t* buffer, uint16_t length, msg_flags flags, const sockets::endpoint &remote_ep);
+        ssize_t send_batch(std::span<const outgoing_datagram> datagrams, msg_flags flags);
+        bool wait_readable(std::chrono::milliseconds timeout);
+        void close();
+
+    private:
+        struct completion {
+            int32_t result;
+            uint32_t flags;
+        };
+
+        ssize_t send_chain(std::span<const outgoing_datagram> datagrams, msg_flags flags);
+        void arm_receive();
+        void reap();
+        void reap_sends();
+        void recycle(uint16_t buffer_id);
+        void teardown();
+        io_uring_sqe* next_sqe(io_uring& ring);
+
+        io_uring m_ring{};
+        io_uring m_send_ring{};
+        io_uring_buf_ring* m_buffer_ring = nullptr;
+        std::array<std::array<uint8_t, RECEIVE_BUFFER_SIZE>, RECEIVE_BUFFERS> m_buffers{};
+        msghdr m_receive_header{};
+        bool m_receive_armed = false;
+        bool m_open = false;
+
+        // Receive completions reaped while waiting on sends, each one holds a provided buffer so there are never more than RECEIVE_BUFFERS
+        std::array<completion, RECEIVE_BUFFERS> m_received{};
+        uint32_t m_received_head = 0;
+        uint32_t m_received_tail = 0;
+
+        std::array<msghdr, MAX_BATCH> m_send_headers{};
+        std::array<iovec, MAX_BATCH> m_send_vectors{};
+        std::array<int32_t, MAX_BATCH> m_send_results{};
+        size_t m_sends_outstanding = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include <whb/crash.h>
+#include <whb/log.h>
+#include <whb/log_udp.h>
+#include <whb/proc.h>
+#include <vpad/input.h>
+#include <padscore/wpad.h>
+
+#include <atomic>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+
+/*
+ * The console services the server calls, reduced to what a Linux host can stand in for:
+ * signals end the process loop, logs go to stderr, and the GamePad lies still with nothing pressed.
+ */
+namespace {
+    std::atomic<bool> running{true};
+
+    void stop(int) {
+        running.store(false, std::memory_order_relaxed);
+    }
+
+    BOOL write_log(const char* format, va_list args, bool newline) {
+        std::vfprintf(stderr, format, args);
+        if (newline)
+            std::fputc('\n', stderr);
+        return TRUE;
+    }
+}
+
+extern "C" {
+    void WHBProcInit() {
+        std::signal(SIGINT, stop);
+        std::signal(SIGTERM, stop);
+    }
+
+    void WHBProcShutdown() {}
+
+    BOOL WHBProcIsRunning() {
+        return running.load(std::memory_order_relaxed) ? TRUE : FALSE;
+    }
+
+    BOOL WHBLogPrint(const char* str) {
+        std::fputs(str, stderr);
+        std::fputc('\n', stderr);
+        return TRUE;
+    }
+
+    BOOL WHBLogPrintf(const char* fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        const auto result = write_log(fmt, args, true);
+        va_end(args);
+        return result;
+    }
+
+    BOOL WHBLogWrite(const char* str) {
+        std::fputs(str, stderr);
+        return TRUE;
+    }
+
+    BOOL WHBLogWritef(const char* fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        const auto result = write_log(fmt, args, false);
+        va_end(args);
+        return result;
+    }
+
+    BOOL WHBLogUdpInit() {
+        return TRUE;
+    }
+
+    BOOL WHBLogUdpDeinit() {
+        return TRUE;
+    }
+
+    BOOL WHBInitCrashHandler() {
+        return TRUE;
+    }
+
+    int32_t VPADRead(VPADChan, VPADStatus* buffers, uint32_t count, VPADReadError* outError) {
+        if (count == 0) {
+            *outError = VPAD_READ_NO_SAMPLES;
+            return 0;
+        }
+        buffers[0] = VPADStatus{};
+        // Gravity only, as read from a GamePad lying face up
+        buffers[0].accelorometer.acc = {0.0f, -1.0f, 0.0f};
+        buffers[0].accelorometer.magnitude = 1.0f;
+        // Reported to clients as a full battery
+        buffers[0].battery = 30;
+        *outError = VPAD_READ_SUCCESS;
+        return 1;
+    }
+
+    int32_t VPADControlMotor(VPADChan, uint8_t*, uint8_t) {
+        return 0;
+    }
+
+    void VPADStopMotor(VPADChan) {}
+
+    void WPADInit() {}
+
+    void WPADShutdown() {}
+
+    int32_t WPADProbe(WPADChan, WPADExtensionType*) {
+        return WPAD_ERROR_NO_CONTROLLER;
+    }
+
+    void WPADControlMotor(WPADChan, uint32_t) {}
+}
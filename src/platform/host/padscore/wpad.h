@@ -0,0 +1,38 @@
+#pragma once
+
+#include <wut_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum WPADChan {
+    WPAD_CHAN_0 = 0,
+    WPAD_CHAN_1 = 1,
+    WPAD_CHAN_2 = 2,
+    WPAD_CHAN_3 = 3
+} WPADChan;
+
+typedef enum WPADExtensionType {
+    WPAD_EXT_CORE = 0
+} WPADExtensionType;
+
+typedef enum WPADError {
+    WPAD_ERROR_NONE = 0,
+    WPAD_ERROR_NO_CONTROLLER = -1
+} WPADError;
+
+void WPADInit();
+
+void WPADShutdown();
+
+/**
+ * Hosts have no Wii Remotes, every channel reports WPAD_ERROR_NO_CONTROLLER
+ */
+int32_t WPADProbe(WPADChan chan, WPADExtensionType* outExtensionType);
+
+void WPADControlMotor(WPADChan chan, uint32_t onOff);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <wut_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hosts leave crashes to the system's own core dumps
+BOOL WHBInitCrashHandler();
+
+#ifdef __cplusplus
+}
+#endif
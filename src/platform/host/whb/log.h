@@ -0,0 +1,25 @@
+#pragma once
+
+#include <wut_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Writes a line to stderr
+ */
+BOOL WHBLogPrint(const char* str);
+
+BOOL WHBLogPrintf(const char* fmt, ...);
+
+/**
+ * Writes to stderr without ending the line
+ */
+BOOL WHBLogWrite(const char* str);
+
+BOOL WHBLogWritef(const char* fmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
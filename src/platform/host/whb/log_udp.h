@@ -0,0 +1,16 @@
+#pragma once
+
+#include <wut_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host logs always go to stderr, there is nothing to set up
+BOOL WHBLogUdpInit();
+
+BOOL WHBLogUdpDeinit();
+
+#ifdef __cplusplus
+}
+#endif
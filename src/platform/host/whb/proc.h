@@ -0,0 +1,23 @@
+#pragma once
+
+#include <wut_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Installs SIGINT and SIGTERM handlers, either one ends the process loop
+ */
+void WHBProcInit();
+
+void WHBProcShutdown();
+
+/**
+ * @return TRUE until the process is asked to stop
+ */
+BOOL WHBProcIsRunning();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+// Host stand-in for WUT's basic types, only the parts the platform headers below use
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int32_t BOOL;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
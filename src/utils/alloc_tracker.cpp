@@ -0,0 +1,136 @@
+#include "alloc_tracker.h"
+
+#include <atomic>
+
+#ifdef DSU_TRACK_ALLOCATIONS
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace utils::alloc_tracker {
+    namespace {
+        std::atomic<bool> steady{false};
+        std::atomic<uint32_t> allocations{0};
+    }
+
+    void mark_steady_state() {
+        allocations.store(0, std::memory_order_relaxed);
+        steady.store(true, std::memory_order_release);
+    }
+
+    uint32_t steady_state_allocations() {
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+#ifdef DSU_TRACK_ALLOCATIONS
+    void count() {
+        if (steady.load(std::memory_order_relaxed))
+            allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+}
+
+#ifdef DSU_TRACK_ALLOCATIONS
+// Every form of operator new is replaced, so an array or over-aligned allocation can't slip past the count.
+// All of them allocate with malloc or aligned_alloc, so every operator delete frees with free().
+namespace {
+    void* allocate(std::size_t size) {
+        utils::alloc_tracker::count();
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* allocate(std::size_t size, std::align_val_t alignment) {
+        utils::alloc_tracker::count();
+        const auto align = static_cast<std::size_t>(alignment);
+        // aligned_alloc takes sizes that are a multiple of the alignment
+        return std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align);
+    }
+
+    void* allocate_or_throw(void* memory) {
+        if (memory == nullptr)
+            throw std::bad_alloc();
+        return memory;
+    }
+}
+
+void* operator new(std::size_t size) {
+    return allocate_or_throw(allocate(size));
+}
+
+void* operator new[](std::size_t size) {
+    return allocate_or_throw(allocate(size));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(allocate(size, alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(allocate(size, alignment));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+namespace utils::alloc_tracker {
+    /**
+     * Whether global operator new is being counted, set with the DSU_TRACK_ALLOCATIONS build option
+     */
+#ifdef DSU_TRACK_ALLOCATIONS
+    constexpr bool enabled = true;
+#else
+    constexpr bool enabled = false;
+#endif
+
+    /**
+     * Marks the end of warm-up, every allocation from here on is counted
+     */
+    void mark_steady_state();
+
+    /**
+     * @return the number of allocations made since the steady state was marked, always 0 when tracking is disabled
+     */
+    uint32_t steady_state_allocations();
+}
@@ -0,0 +1,212 @@
+#include "deferred_log.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <thread>
+
+#ifdef __WIIU__
+#include <coreinit/time.h>
+#include <whb/log.h>
+#endif
+
+#ifndef APPLICATION_NAME
+#define APPLICATION_NAME ""
+#endif
+
+namespace utils::log {
+    namespace {
+        // Rings are never returned, a thread started after all of them are taken logs nothing
+        constexpr size_t MAX_RINGS = 8;
+        constexpr size_t LINE_LENGTH = 256;
+
+        std::array<ring, MAX_RINGS> rings;
+        std::atomic<uint32_t> rings_claimed{0};
+        // Records from threads that found no free ring
+        std::atomic<uint32_t> unowned_dropped{0};
+
+        std::atomic<bool> draining{false};
+        pinned_thread drain_thread;
+
+        void emit(const char* line) {
+#ifdef __WIIU__
+            WHBLogPrint(line);
+#else
+            std::fputs(line, stderr);
+            std::fputc('\n', stderr);
+#endif
+        }
+
+        uint64_t to_microseconds(uint64_t time) {
+#ifdef __WIIU__
+            return OSTicksToMicroseconds(time);
+#else
+            return time / 1000;
+#endif
+        }
+
+        char severity_letter(level severity) {
+            constexpr std::array<char, 4> letters{'E', 'W', 'I', 'D'};
+            return letters[static_cast<uint8_t>(severity)];
+        }
+
+        bool is_any_of(char value, const char* set) {
+            return value != '\0' && std::strchr(set, value) != nullptr;
+        }
+
+        /**
+         * Formats a single conversion from the format string using the type recorded for its argument
+         * @return the number of characters written
+         */
+        size_t format_arg(char* out, size_t capacity, std::string_view flags, char conversion, const record& entry, size_t index) {
+            char spec[16] = "%";
+            const auto flagLength = std::min(flags.size(), sizeof(spec) - 5);
+            std::memcpy(spec + 1, flags.data(), flagLength);
+            char* tail = spec + 1 + flagLength;
+
+            const auto value = entry.args[index];
+            int written = 0;
+            switch (entry.types[index]) {
+                case arg_type::SIGNED:
+                case arg_type::UNSIGNED: {
+                    if (is_any_of(conversion, "fFeEgG")) {
+                        *tail = conversion;
+                        const auto number = entry.types[index] == arg_type::SIGNED ? static_cast<double>(static_cast<int64_t>(value)) : static_cast<double>(value);
+                        written = std::snprintf(out, capacity, spec, number);
+                    }
+                    else if (conversion == 'c') {
+                        *tail = 'c';
+                        written = std::snprintf(out, capacity, spec, static_cast<int>(value));
+                    }
+                    else {
+                        tail[0] = 'l';
+                        tail[1] = 'l';
+                        tail[2] = is_any_of(conversion, "diuoxX") ? conversion : 'u';
+                        if (tail[2] == 'd' || tail[2] == 'i')
+                            written = std::snprintf(out, capacity, spec, static_cast<long long>(value));
+                        else
+                            written = std::snprintf(out, capacity, spec, static_cast<unsigned long long>(value));
+                    }
+                    break;
+                }
+                case arg_type::FLOATING:
+                    *tail = is_any_of(conversion, "fFeEgG") ? conversion : 'f';
+                    written = std::snprintf(out, capacity, spec, std::bit_cast<double>(value));
+                    break;
+                case arg_type::STRING:
+                    *tail = 's';
+                    written = std::snprintf(out, capacity, spec, value < STRING_BYTES ? entry.strings.data() + value : "");
+                    break;
+                case arg_type::IPV4: {
+                    char address[16];
+                    std::snprintf(address, sizeof(address), "%u.%u.%u.%u",
+                                  static_cast<unsigned>((value >> 24) & 0xFF), static_cast<unsigned>((value >> 16) & 0xFF),
+                                  static_cast<unsigned>((value >> 8) & 0xFF), static_cast<unsigned>(value & 0xFF));
+                    *tail = 's';
+                    written = std::snprintf(out, capacity, spec, address);
+                    break;
+                }
+                case arg_type::POINTER:
+                    *tail = 'p';
+                    written = std::snprintf(out, capacity, spec, reinterpret_cast<void*>(static_cast<uintptr_t>(value)));
+                    break;
+            }
+            if (written < 0)
+                return 0;
+            return std::min(static_cast<size_t>(written), capacity - 1);
+        }
+
+        void format(const record& entry, char* out, size_t capacity) {
+            const auto& origin = *entry.origin;
+            const auto micros = to_microseconds(entry.time);
+            auto length = static_cast<size_t>(std::snprintf(out, capacity, "[%s][%c][%8llu.%03llu][%23s]%30s@L%04u: ",
+                                                            APPLICATION_NAME, severity_letter(origin.severity),
+                                                            static_cast<unsigned long long>(micros / 1000), static_cast<unsigned long long>(micros % 1000),
+                                                            origin.file, origin.function, static_cast<unsigned>(origin.line)));
+            length = std::min(length, capacity - 1);
+            if (entry.dropped != 0)
+                length += std::min<size_t>(std::snprintf(out + length, capacity - length, "(%u dropped) ", static_cast<unsigned>(entry.dropped)), capacity - length - 1);
+
+            size_t argIndex = 0;
+            for (auto cursor = origin.format; *cursor != '\0' && length < capacity - 1;) {
+                if (*cursor != '%') {
+                    out[length++] = *cursor++;
+                    continue;
+                }
+                if (cursor[1] == '%') {
+                    out[length++] = '%';
+                    cursor += 2;
+                    continue;
+                }
+                const auto flagsStart = ++cursor;
+                while (is_any_of(*cursor, "-+ #0123456789."))
+                    ++cursor;
+                const std::string_view flags(flagsStart, cursor - flagsStart);
+                // Length modifiers are dropped, the recorded type decides the width
+                while (is_any_of(*cursor, "hljztL"))
+                    ++cursor;
+                const auto conversion = *cursor;
+                if (conversion != '\0')
+                    ++cursor;
+                if (argIndex >= entry.arg_count)
+                    continue;
+                length += format_arg(out + length, capacity - length, flags, conversion, entry, argIndex++);
+            }
+            out[length] = '\0';
+        }
+
+        size_t drain_once() {
+            char line[LINE_LENGTH];
+            size_t drained = 0;
+            const auto claimed = std::min<uint32_t>(rings_claimed.load(std::memory_order_acquire), MAX_RINGS);
+            for (uint32_t i = 0; i < claimed; ++i) {
+                while (const auto* entry = rings[i].peek()) {
+                    format(*entry, line, sizeof(line));
+                    rings[i].pop();
+                    emit(line);
+                    ++drained;
+                }
+            }
+            if (const auto lost = unowned_dropped.exchange(0, std::memory_order_relaxed); lost != 0) {
+                std::snprintf(line, sizeof(line), "[%s] %u records dropped by threads without a log ring", APPLICATION_NAME, static_cast<unsigned>(lost));
+                emit(line);
+            }
+            return drained;
+        }
+    }
+
+    ring* thread_ring() {
+        thread_local ring* const own = [] {
+            const auto index = rings_claimed.fetch_add(1, std::memory_order_acq_rel);
+            return index < MAX_RINGS ? &rings[index] : nullptr;
+        }();
+        if (own == nullptr)
+            unowned_dropped.fetch_add(1, std::memory_order_relaxed);
+        return own;
+    }
+
+    uint64_t now() {
+#ifdef __WIIU__
+        return OSGetTime();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    void start(const thread_placement& placement) {
+        if (draining.exchange(true))
+            return;
+        drain_thread = pinned_thread(placement, [] {
+            while (draining.load(std::memory_order_relaxed)) {
+                if (drain_once() == 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+            drain_once();
+        });
+    }
+
+    void stop() {
+        draining = false;
+        drain_thread.join();
+    }
+}
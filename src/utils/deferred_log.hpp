@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "pinned_thread.h"
+
+namespace utils::log {
+    enum class level : uint8_t {
+        ERROR = 0,
+        WARN = 1,
+        INFO = 2,
+        DEBUG = 3
+    };
+
+    /**
+     * Everything about a log statement that is known at compile time, its address doubles as the format id
+     */
+    struct site {
+        level severity;
+        const char* format;
+        const char* file;
+        const char* function;
+        uint32_t line;
+    };
+
+    /**
+     * @return the part of a path after the last separator
+     */
+    constexpr const char* file_name(const char* path) {
+        const char* name = path;
+        for (auto cursor = path; *cursor != '\0'; ++cursor) {
+            if (*cursor == '/' || *cursor == '\\')
+                name = cursor + 1;
+        }
+        return name;
+    }
+
+    /**
+     * An IPv4 address in host order, formatted in dotted notation by the drain thread so that
+     * logging an endpoint doesn't need inet_ntoa on the calling thread
+     */
+    struct ipv4 {
+        uint32_t value;
+    };
+
+    enum class arg_type : uint8_t {
+        SIGNED,
+        UNSIGNED,
+        FLOATING,
+        STRING,
+        POINTER,
+        IPV4
+    };
+
+    constexpr size_t MAX_ARGS = 6;
+    constexpr size_t STRING_BYTES = 32;
+
+    struct record {
+        const site* origin;
+        uint64_t time;
+        // Records lost on this ring since the previous one was written
+        uint32_t dropped;
+        uint8_t arg_count;
+        uint8_t string_bytes;
+        std::array<arg_type, MAX_ARGS> types;
+        std::array<uint64_t, MAX_ARGS> args;
+        // Copies of string arguments, back to back and null terminated, args holds the offset
+        std::array<char, STRING_BYTES> strings;
+    };
+
+    /**
+     * Single producer, single consumer ring of records, each logging thread owns one
+     */
+    class ring {
+    public:
+        static constexpr uint32_t CAPACITY = 64;
+
+        /**
+         * Reserves the next free record, nullptr if the ring is full
+         */
+        record* claim() {
+            const auto head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) == CAPACITY) {
+                ++m_dropped;
+                return nullptr;
+            }
+            auto& entry = m_records[head % CAPACITY];
+            entry.dropped = m_dropped;
+            m_dropped = 0;
+            return &entry;
+        }
+
+        /**
+         * Hands the last claimed record over to the consumer
+         */
+        void publish() {
+            m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * @return the oldest unconsumed record, nullptr if empty
+         */
+        const record* peek() const {
+            const auto tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire))
+                return nullptr;
+            return &m_records[tail % CAPACITY];
+        }
+
+        void pop() {
+            m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+        std::array<record, CAPACITY> m_records{};
+        std::atomic<uint32_t> m_head{0};
+        std::atomic<uint32_t> m_tail{0};
+        uint32_t m_dropped = 0;
+    };
+
+    /**
+     * @return the ring for the calling thread, nullptr once every ring has been handed out
+     */
+    ring* thread_ring();
+
+    /**
+     * @return the current time in the units stored in records
+     */
+    uint64_t now();
+
+    namespace detail {
+        inline void encode(record& entry, size_t index, const char* value) {
+            if (value == nullptr)
+                value = "(null)";
+            entry.types[index] = arg_type::STRING;
+            const auto available = STRING_BYTES - entry.string_bytes;
+            if (available < 2) {
+                // Out of space, an offset past the end formats as an empty string
+                entry.args[index] = STRING_BYTES;
+                return;
+            }
+            const auto length = std::min(std::strlen(value), available - 1);
+            std::memcpy(entry.strings.data() + entry.string_bytes, value, length);
+            entry.strings[entry.string_bytes + length] = '\0';
+            entry.args[index] = entry.string_bytes;
+            entry.string_bytes += length + 1;
+        }
+
+        template <size_t Size>
+        void encode(record& entry, size_t index, const std::array<char, Size>& value) {
+            char terminated[Size + 1]{};
+            std::memcpy(terminated, value.data(), Size);
+            encode(entry, index, static_cast<const char*>(terminated));
+        }
+
+        inline void encode(record& entry, size_t index, ipv4 value) {
+            entry.types[index] = arg_type::IPV4;
+            entry.args[index] = value.value;
+        }
+
+        template <typename T>
+        void encode(record& entry, size_t index, T value) {
+            if constexpr (std::is_same_v<T, char*>) {
+                encode(entry, index, static_cast<const char*>(value));
+            }
+            else if constexpr (std::is_enum_v<T>) {
+                encode(entry, index, static_cast<std::underlying_type_t<T>>(value));
+            }
+            else if constexpr (std::is_floating_point_v<T>) {
+                entry.types[index] = arg_type::FLOATING;
+                entry.args[index] = std::bit_cast<uint64_t>(static_cast<double>(value));
+            }
+            else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                entry.types[index] = arg_type::SIGNED;
+                entry.args[index] = static_cast<uint64_t>(static_cast<int64_t>(value));
+            }
+            else if constexpr (std::is_integral_v<T>) {
+                entry.types[index] = arg_type::UNSIGNED;
+                entry.args[index] = static_cast<uint64_t>(value);
+            }
+            else if constexpr (std::is_pointer_v<T>) {
+                entry.types[index] = arg_type::POINTER;
+                entry.args[index] = reinterpret_cast<uintptr_t>(value);
+            }
+            else {
+                static_assert(std::is_integral_v<T>, "unsupported log argument type");
+            }
+        }
+    }
+
+    /**
+     * Copies the raw arguments of a log statement into the calling thread's ring, formatting happens on the drain thread
+     * @param origin the log statement
+     * @param args arguments matching the conversions in the format string
+     */
+    template <typename... Args>
+    void push(const site& origin, const Args&... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many log arguments");
+        auto* target = thread_ring();
+        if (target == nullptr)
+            return;
+        auto* entry = target->claim();
+        if (entry == nullptr)
+            return;
+        entry->origin = &origin;
+        entry->time = now();
+        entry->arg_count = sizeof...(Args);
+        entry->string_bytes = 0;
+        size_t index = 0;
+        (detail::encode(*entry, index++, args), ...);
+        target->publish();
+    }
+
+    /**
+     * Starts the thread that formats records and ships them over WHB logging
+     * @param placement where to run the drain thread
+     */
+    void start(const thread_placement& placement);
+
+    /**
+     * Drains whatever is left and stops the drain thread
+     */
+    void stop();
+}
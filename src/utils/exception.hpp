@@ -1,13 +1,30 @@
 #pragma once
 #include <stdexcept>
 #include <cerrno>
+#include <cstdio>
 #include <cstring>
 
 namespace utils {
     class errno_error  : public std::runtime_error {
+        int m_code;
+        // Formatted in place rather than through std::string so raising this doesn't touch the heap for the message
+        char m_message[96]{};
     public:
-        errno_error() : runtime_error(std::string{"Error " + std::to_string(errno) + ": "} + strerror(errno)){
+        errno_error() : errno_error(errno) {}
 
+        explicit errno_error(int code) : runtime_error(""), m_code(code) {
+            std::snprintf(m_message, sizeof(m_message), "Error %d: %s", code, std::strerror(code));
+        }
+
+        [[nodiscard]] const char* what() const noexcept override {
+            return m_message;
+        }
+
+        /**
+         * @return the errno value this error was raised for
+         */
+        [[nodiscard]] int code() const {
+            return m_code;
         }
     };
-}
\ No newline at end of file
+}
@@ -3,8 +3,11 @@
  * */
 
 #pragma once
-#include <wut_types.h>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <climits>
 
@@ -25,8 +28,9 @@ constexpr T bswap(T i)
     return (T)bswap_impl<U>((U)i, std::make_index_sequence<sizeof(T)>{});
 }
 
+// reverses the bytes whatever the native order
 template <typename T>
-constexpr T SwapEndian(T value)
+constexpr T ByteSwap(T value)
 {
     if constexpr (std::is_integral<T>::value)
     {
@@ -47,7 +51,7 @@ constexpr T SwapEndian(T value)
     }
     else if constexpr (std::is_enum<T>::value)
     {
-        return (T)SwapEndian((std::underlying_type_t<T>)value);
+        return (T)ByteSwap((std::underlying_type_t<T>)value);
     }
     else if constexpr (std::is_base_of<Latte::LATTEREG, T>::value)
     {
@@ -62,12 +66,24 @@ constexpr T SwapEndian(T value)
     return value;
 }
 
+// converts between native and little endian, the byte order of the wire format
+template <typename T>
+constexpr T SwapEndian(T value)
+{
+    if constexpr (std::endian::native == std::endian::little)
+        return value;
+    else
+        return ByteSwap(value);
+}
 
 // swap if native isn't big endian
 template <typename T>
 constexpr T _BE(T value)
 {
-    return value;
+    if constexpr (std::endian::native == std::endian::big)
+        return value;
+    else
+        return ByteSwap(value);
 }
 
 // swap if native isn't little endian
@@ -1,31 +1,51 @@
 #pragma once
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
 #include <string.h>
 #include <whb/log.h>
 #include <whb/crash.h>
 
-#define __FILENAME_X__ (strrchr(__FILE__, '\\') ? strrchr(__FILE__, '\\') + 1 : __FILE__)
-#define __FILENAME__   (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILENAME_X__)
+#include "deferred_log.hpp"
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN  1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+
+// Statements above this level are compiled out entirely
+#ifndef DSU_LOG_LEVEL
+#ifdef NDEBUG
+#define DSU_LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define DSU_LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+#define __FILENAME__ (utils::log::file_name(__FILE__))
 
 #define OSFATAL_FUNCTION_LINE(FMT, ARGS...)                                                    \
     do {                                                                                       \
         OSFatal_printf("[%s]%s@L%04d: " FMT "", __FILENAME__, __FUNCTION__, __LINE__, ##ARGS); \
     } while (0)
 
-#define DEBUG_FUNCTION_LINE(FMT, ARGS...)                                                        \
-    do {                                                                                         \
-        WHBLogPrintf("[%s][%23s]%30s@L%04d: " FMT "", APPLICATION_NAME, __FILENAME__, __FUNCTION__, __LINE__, ##ARGS); \
-    } while (0);
+/*
+ * Records the raw arguments into the calling thread's log ring, the drain thread formats them later.
+ * Arguments must be integers, enums, floats, pointers, strings (copied, truncated) or utils::log::ipv4.
+ */
+#define LOG_FUNCTION_LINE(LEVEL, FMT, ARGS...)                                                                        \
+    do {                                                                                                              \
+        if constexpr (LOG_LEVEL_##LEVEL <= DSU_LOG_LEVEL) {                                                           \
+            static constexpr utils::log::site log_site{utils::log::level::LEVEL, FMT, __FILENAME__, __FUNCTION__, __LINE__}; \
+            utils::log::push(log_site, ##ARGS);                                                                       \
+        }                                                                                                             \
+    } while (0)
+
+#define ERROR_FUNCTION_LINE(FMT, ARGS...) LOG_FUNCTION_LINE(ERROR, FMT, ##ARGS)
+#define WARN_FUNCTION_LINE(FMT, ARGS...)  LOG_FUNCTION_LINE(WARN, FMT, ##ARGS)
+#define INFO_FUNCTION_LINE(FMT, ARGS...)  LOG_FUNCTION_LINE(INFO, FMT, ##ARGS)
+#define DEBUG_FUNCTION_LINE(FMT, ARGS...) LOG_FUNCTION_LINE(DEBUG, FMT, ##ARGS)
 
+// Writes synchronously, for use before the drain thread has started or after it has stopped
 #define DEBUG_FUNCTION_LINE_WRITE(FMT, ARGS...)                                                  \
     do {                                                                                         \
         WHBLogWritef("[%23s]%30s@L%04d: " FMT "", __FILENAME__, __FUNCTION__, __LINE__, ##ARGS); \
-    } while (0);
-
-#ifdef __cplusplus
-}
-#endif
+    } while (0)
@@ -0,0 +1,202 @@
+#include "pinned_thread.h"
+
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __WIIU__
+#include <coreinit/thread.h>
+#else
+#include <thread>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#endif
+
+namespace utils {
+    size_t thread_layout::load(const char* path) {
+        auto* const file = std::fopen(path, "r");
+        if (file == nullptr)
+            return 0;
+        const std::pair<const char*, thread_placement*> threads[] = {
+            {"receive", &receive}, {"decode", &decode}, {"sampling", &sampling}, {"transmit", &transmit}, {"logging", &logging}
+        };
+        const std::pair<const char*, thread_priority> priorities[] = {
+            {"background", thread_priority::BACKGROUND}, {"normal", thread_priority::NORMAL},
+            {"latency_critical", thread_priority::LATENCY_CRITICAL}
+        };
+        size_t changed = 0;
+        char line[64];
+        while (std::fgets(line, sizeof(line), file) != nullptr) {
+            char thread[16];
+            char priority[20];
+            int core;
+            if (std::sscanf(line, " %15s %d %19s", thread, &core, priority) != 3 || core < -1 || core > 2)
+                continue;
+            thread_placement* placement = nullptr;
+            for (const auto& [name, target] : threads) {
+                if (std::strcmp(name, thread) == 0)
+                    placement = target;
+            }
+            for (const auto& [name, value] : priorities) {
+                if (placement != nullptr && std::strcmp(name, priority) == 0) {
+                    placement->core = core;
+                    placement->priority = value;
+                    ++changed;
+                }
+            }
+        }
+        std::fclose(file);
+        return changed;
+    }
+
+    bool thread_layout::separate_background() {
+        const auto shares_core = [this](const thread_placement& placement) {
+            if (placement.core < 0)
+                return false;
+            for (const auto* critical : {&receive, &decode, &sampling, &transmit}) {
+                if (critical->priority == thread_priority::LATENCY_CRITICAL && critical->core == placement.core)
+                    return true;
+            }
+            return false;
+        };
+        if (!shares_core(logging))
+            return false;
+        for (int core = 0; core < 3; ++core) {
+            logging.core = core;
+            if (!shares_core(logging))
+                return true;
+        }
+        logging.core = -1;
+        return true;
+    }
+
+#ifdef __WIIU__
+    namespace {
+        constexpr uint32_t STACK_SIZE = 0x10000;
+
+        int32_t os_priority(thread_priority priority) {
+            // 0 is the highest priority, the main thread runs at 16
+            switch (priority) {
+                case thread_priority::LATENCY_CRITICAL:
+                    return 10;
+                case thread_priority::BACKGROUND:
+                    return 24;
+                default:
+                    return 16;
+            }
+        }
+
+        OSThreadAttributes os_affinity(int core) {
+            switch (core) {
+                case 0:
+                    return OS_THREAD_ATTRIB_AFFINITY_CPU0;
+                case 1:
+                    return OS_THREAD_ATTRIB_AFFINITY_CPU1;
+                case 2:
+                    return OS_THREAD_ATTRIB_AFFINITY_CPU2;
+                default:
+                    return OS_THREAD_ATTRIB_AFFINITY_ANY;
+            }
+        }
+    }
+
+    struct pinned_thread::state {
+        OSThread thread{};
+        std::unique_ptr<uint64_t[]> stack{new uint64_t[STACK_SIZE / sizeof(uint64_t)]};
+        std::function<void()> function;
+        bool joinable = false;
+        bool applied = false;
+
+        static int entry(int, const char** argv) {
+            auto* self = reinterpret_cast<state*>(argv);
+            self->function();
+            return 0;
+        }
+    };
+
+    pinned_thread::pinned_thread(const thread_placement& placement, std::function<void()> function)
+    : m_state(std::make_unique<state>()) {
+        m_state->function = std::move(function);
+        auto* stackTop = reinterpret_cast<uint8_t*>(m_state->stack.get()) + STACK_SIZE;
+        const auto created = OSCreateThread(&m_state->thread, state::entry, 0, reinterpret_cast<char*>(m_state.get()),
+                                            stackTop, STACK_SIZE, os_priority(placement.priority), os_affinity(placement.core));
+        if (!created)
+            throw std::runtime_error("OSCreateThread failed");
+        OSSetThreadName(&m_state->thread, placement.name);
+        m_state->applied = true;
+        m_state->joinable = true;
+        OSResumeThread(&m_state->thread);
+    }
+
+    void pinned_thread::join() {
+        if (!joinable())
+            return;
+        OSJoinThread(&m_state->thread, nullptr);
+        m_state->joinable = false;
+    }
+
+    bool pinned_thread::joinable() const {
+        return m_state && m_state->joinable;
+    }
+#else
+    struct pinned_thread::state {
+        std::thread thread;
+        bool applied = false;
+    };
+
+    pinned_thread::pinned_thread(const thread_placement& placement, std::function<void()> function)
+    : m_state(std::make_unique<state>()) {
+        m_state->thread = std::thread(std::move(function));
+#ifdef __linux__
+        const auto handle = m_state->thread.native_handle();
+        bool applied = true;
+        if (placement.core >= 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(placement.core, &cpus);
+            applied &= pthread_setaffinity_np(handle, sizeof(cpus), &cpus) == 0;
+        }
+        if (placement.priority == thread_priority::LATENCY_CRITICAL) {
+            // Needs CAP_SYS_NICE or an rtprio limit, without it the thread stays on SCHED_OTHER
+            sched_param param{};
+            param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+            applied &= pthread_setschedparam(handle, SCHED_FIFO, &param) == 0;
+        }
+        if (placement.name[0] != '\0')
+            pthread_setname_np(handle, placement.name);
+        m_state->applied = applied;
+#endif
+    }
+
+    void pinned_thread::join() {
+        if (joinable())
+            m_state->thread.join();
+    }
+
+    bool pinned_thread::joinable() const {
+        return m_state && m_state->thread.joinable();
+    }
+#endif
+
+    pinned_thread::pinned_thread() = default;
+
+    pinned_thread::pinned_thread(pinned_thread&&) noexcept = default;
+
+    pinned_thread& pinned_thread::operator=(pinned_thread&& other) noexcept {
+        join();
+        m_state = std::move(other.m_state);
+        return *this;
+    }
+
+    pinned_thread::~pinned_thread() {
+        join();
+    }
+
+    bool pinned_thread::placement_applied() const {
+        return m_state && m_state->applied;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace utils {
+    enum class thread_priority {
+        BACKGROUND,
+        NORMAL,
+        LATENCY_CRITICAL
+    };
+
+    /**
+     * Where a thread runs and how it competes with the threads around it
+     */
+    struct thread_placement {
+        // -1 lets the scheduler pick
+        int core = -1;
+        thread_priority priority = thread_priority::NORMAL;
+        const char* name = "";
+    };
+
+    /**
+     * Placement of every thread the server starts, set up once at startup from the defaults below and an optional file
+     */
+    struct thread_layout {
+        // Pipeline stages, receive and transmit share a core as both mostly wait on the socket, decode owns the client registry,
+        // sampling gets a core to itself so waiting out its tick deadlines never holds up another stage
+        thread_placement receive{0, thread_priority::LATENCY_CRITICAL, "dsu_receive"};
+        thread_placement decode{1, thread_priority::NORMAL, "dsu_decode"};
+        thread_placement sampling{2, thread_priority::LATENCY_CRITICAL, "dsu_sampling"};
+        thread_placement transmit{0, thread_priority::LATENCY_CRITICAL, "dsu_transmit"};
+        thread_placement logging{1, thread_priority::BACKGROUND, "dsu_logging"};
+
+        /**
+         * Overrides placements from a text file, one "<thread> <core> <priority>" line per thread to move.
+         * Threads are receive, decode, sampling, transmit and logging, priorities background, normal and latency_critical,
+         * a core of -1 lets the scheduler pick. Lines that don't parse are skipped.
+         * @param path the file to read
+         * @return the number of placements changed, 0 when the file doesn't exist
+         */
+        size_t load(const char* path);
+
+        /**
+         * Moves background work off any core the latency critical threads have been placed on
+         * @return whether the layout had to be changed
+         */
+        bool separate_background();
+    };
+
+    /**
+     * A thread started with an explicit core affinity and priority.
+     * Uses OSCreateThread on console and pthread affinity plus SCHED_FIFO on Linux hosts,
+     * on anything else it falls back to an unplaced std::thread.
+     */
+    class pinned_thread {
+        struct state;
+        std::unique_ptr<state> m_state;
+    public:
+        pinned_thread();
+        /**
+         * @param placement the core, priority and name of the thread
+         * @param function the function the thread runs
+         */
+        pinned_thread(const thread_placement& placement, std::function<void()> function);
+
+        pinned_thread(pinned_thread&&) noexcept;
+        pinned_thread& operator=(pinned_thread&&) noexcept;
+
+        ~pinned_thread();
+
+        /**
+         * Waits for the thread to finish
+         */
+        void join();
+
+        [[nodiscard]] bool joinable() const;
+
+        /**
+         * @return whether the requested affinity and priority were accepted by the system,
+         * a Linux host without CAP_SYS_NICE refuses SCHED_FIFO for example
+         */
+        [[nodiscard]] bool placement_applied() const;
+    };
+}
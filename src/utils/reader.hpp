@@ -51,6 +51,7 @@ namespace utils {
          */
         void read(std::vector<uint8_t>& out_container, size_t size, size_t offset = 0){
             std::copy(m_data + m_cursor, m_data + m_cursor + size, out_container.begin() + offset);
+            m_cursor += size;
         }
 
         /**
@@ -61,6 +62,7 @@ namespace utils {
          */
         void read(uint8_t* out_container, size_t size, size_t offset = 0){
             std::copy(m_data + m_cursor, m_data + m_cursor + size, out_container + offset);
+            m_cursor += size;
         }
 
         /**
@@ -71,6 +73,7 @@ namespace utils {
          */
         void read(void* out_container, size_t size, size_t offset = 0){
             std::memcpy(reinterpret_cast<uint8_t*>(out_container) + offset, m_data + m_cursor, size);
+            m_cursor += size;
         }
 
         /**
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace utils {
+    /**
+     * Bounded single producer, single consumer queue of preallocated entries, filled and drained in place.
+     * The producer counts the times it found the queue full and the deepest it has been, both readable from any thread.
+     * @tparam T the entry type, default constructed once up front
+     * @tparam Capacity the number of entries
+     */
+    template <typename T, uint32_t Capacity>
+    class spsc_ring {
+        std::array<T, Capacity> m_entries{};
+        alignas(64) std::atomic<uint32_t> m_head{0};
+        alignas(64) std::atomic<uint32_t> m_tail{0};
+        std::atomic<uint32_t> m_stalls{0};
+        std::atomic<uint32_t> m_high_water{0};
+    public:
+        /**
+         * Producer only, reserves the next free entry
+         * @return the entry to fill, nullptr if the queue is full
+         */
+        T* claim() {
+            const auto head = m_head.load(std::memory_order_relaxed);
+            const auto depth = head - m_tail.load(std::memory_order_acquire);
+            if (depth == Capacity) {
+                m_stalls.store(m_stalls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            if (depth + 1 > m_high_water.load(std::memory_order_relaxed))
+                m_high_water.store(depth + 1, std::memory_order_relaxed);
+            return &m_entries[head % Capacity];
+        }
+
+        /**
+         * Producer only, hands the last claimed entry to the consumer
+         */
+        void publish() {
+            m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /**
+         * Consumer only
+         * @return the oldest entry, nullptr if the queue is empty. It stays valid until pop
+         */
+        T* peek() {
+            const auto tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire))
+                return nullptr;
+            return &m_entries[tail % Capacity];
+        }
+
+        /**
+         * Consumer only, releases the entry returned by peek
+         */
+        void pop() {
+            m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        [[nodiscard]] uint32_t depth() const {
+            return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @return how often the producer found the queue full
+         */
+        [[nodiscard]] uint32_t stalls() const {
+            return m_stalls.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @return the deepest the queue has been
+         */
+        [[nodiscard]] uint32_t high_water() const {
+            return m_high_water.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] static constexpr uint32_t capacity() {
+            return Capacity;
+        }
+    };
+}
@@ -0,0 +1,143 @@
+#include "tick_scheduler.h"
+
+#include <algorithm>
+
+#ifdef __WIIU__
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <time.h>
+#else
+#include <thread>
+#endif
+
+namespace utils {
+    namespace {
+        // Bus ticks on console, nanoseconds everywhere else
+        uint64_t clock_now() {
+#ifdef __WIIU__
+            return static_cast<uint64_t>(OSGetSystemTime());
+#elif defined(__linux__)
+            timespec time{};
+            clock_gettime(CLOCK_MONOTONIC, &time);
+            return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_nsec);
+#else
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+        uint64_t to_clock(std::chrono::nanoseconds duration) {
+#ifdef __WIIU__
+            return OSNanosecondsToTicks(duration.count());
+#else
+            return static_cast<uint64_t>(duration.count());
+#endif
+        }
+
+        std::chrono::nanoseconds from_clock(uint64_t ticks) {
+#ifdef __WIIU__
+            return std::chrono::nanoseconds(OSTicksToNanoseconds(ticks));
+#else
+            return std::chrono::nanoseconds(ticks);
+#endif
+        }
+
+        std::chrono::microseconds to_microseconds(uint64_t ticks) {
+#ifdef __WIIU__
+            return std::chrono::microseconds(OSTicksToMicroseconds(ticks));
+#else
+            return std::chrono::microseconds(ticks / 1000);
+#endif
+        }
+
+        void sleep_until(uint64_t deadline) {
+#ifdef __WIIU__
+            const auto now = clock_now();
+            if (deadline > now)
+                OSSleepTicks(static_cast<OSTime>(deadline - now));
+#elif defined(__linux__)
+            const timespec time{static_cast<time_t>(deadline / 1000000000ull), static_cast<long>(deadline % 1000000000ull)};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) {}
+#else
+            const auto now = clock_now();
+            if (deadline > now)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now));
+#endif
+        }
+
+        size_t overrun_bucket(uint64_t missed) {
+            if (missed <= 2)
+                return missed - 1;
+            if (missed <= 4)
+                return 2;
+            if (missed <= 8)
+                return 3;
+            return 4;
+        }
+    }
+
+    tick_scheduler::tick_scheduler(std::chrono::nanoseconds period, overrun_policy policy, std::chrono::nanoseconds spin)
+    : m_period(std::max<uint64_t>(to_clock(period), 1)), m_spin(to_clock(spin)), m_policy(policy) {}
+
+    void tick_scheduler::start() {
+        m_next = clock_now() + m_period;
+    }
+
+    void tick_scheduler::start(std::chrono::nanoseconds now) {
+        m_next = to_clock(now) + m_period;
+    }
+
+    uint32_t tick_scheduler::wait() {
+        if (m_next == 0)
+            start();
+
+        auto now = clock_now();
+        if (now >= m_next)
+            return overrun(now);
+
+        if (m_next - now > m_spin)
+            sleep_until(m_next - m_spin);
+        while ((now = clock_now()) < m_next) {}
+        return on_time(now - m_next);
+    }
+
+    uint32_t tick_scheduler::advance(std::chrono::nanoseconds now) {
+        if (m_next == 0)
+            start(now);
+
+        const auto time = to_clock(now);
+        return time >= m_next ? overrun(time) : on_time(0);
+    }
+
+    std::chrono::nanoseconds tick_scheduler::deadline() const {
+        return from_clock(m_next);
+    }
+
+    uint32_t tick_scheduler::overrun(uint64_t now) {
+        // The caller overran, it's already late for this deadline and maybe later ones
+        const auto missed = (now - m_next) / m_period + 1;
+        uint32_t deadlines = 1;
+        ++m_stats.overruns[overrun_bucket(missed)];
+        if (m_policy == overrun_policy::SKIP && missed > 1) {
+            m_stats.skipped += static_cast<uint32_t>(missed - 1);
+            m_next += (missed - 1) * m_period;
+            deadlines = static_cast<uint32_t>(missed);
+        }
+        ++m_stats.ticks;
+        m_next += m_period;
+        return deadlines;
+    }
+
+    uint32_t tick_scheduler::on_time(uint64_t lateness) {
+        const auto late = to_microseconds(lateness);
+        const auto* const bucket = std::lower_bound(tick_stats::JITTER_BOUNDS_US.begin(), tick_stats::JITTER_BOUNDS_US.end(),
+                                                    static_cast<uint32_t>(std::min<int64_t>(late.count(), UINT32_MAX)));
+        ++m_stats.jitter[bucket - tick_stats::JITTER_BOUNDS_US.begin()];
+        m_stats.worst_lateness = std::max(m_stats.worst_lateness, late);
+        ++m_stats.ticks;
+        m_next += m_period;
+        return 1;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace utils {
+    enum class overrun_policy {
+        // Deadlines that were missed fire back to back until the schedule has caught up
+        CATCH_UP,
+        // Deadlines that were missed are dropped, the next one is the first still in the future
+        SKIP
+    };
+
+    /**
+     * How closely a tick_scheduler has kept to its deadlines
+     */
+    struct tick_stats {
+        // Upper bounds of the jitter buckets, the last bucket takes anything later
+        static constexpr std::array<uint32_t, 5> JITTER_BOUNDS_US{10, 50, 100, 500, 1000};
+
+        // Ticks that fired
+        uint32_t ticks = 0;
+        // How late each tick woke up after sleeping, by JITTER_BOUNDS_US
+        std::array<uint32_t, JITTER_BOUNDS_US.size() + 1> jitter{};
+        // Ticks whose deadline had already passed when they were waited for, by deadlines missed: 1, 2, 3 to 4, 5 to 8, more
+        std::array<uint32_t, 5> overruns{};
+        // Deadlines dropped by the SKIP policy
+        uint32_t skipped = 0;
+        std::chrono::microseconds worst_lateness{};
+    };
+
+    /**
+     * Fires at fixed absolute deadlines, so time spent between ticks never accumulates into drift.
+     * Sleeps with OSSleepTicks on console and clock_nanosleep(TIMER_ABSTIME) on Linux hosts, optionally waking early
+     * and spinning for the rest, since the timers alone overshoot by tens of microseconds.
+     */
+    class tick_scheduler {
+        uint64_t m_period;
+        uint64_t m_spin;
+        overrun_policy m_policy;
+        uint64_t m_next = 0;
+        tick_stats m_stats{};
+
+        uint32_t overrun(uint64_t now);
+        uint32_t on_time(uint64_t lateness);
+    public:
+        /**
+         * @param period the time between deadlines
+         * @param policy what to do about deadlines that passed while the caller was busy
+         * @param spin how long before each deadline to stop sleeping and spin, zero to only sleep
+         */
+        tick_scheduler(std::chrono::nanoseconds period, overrun_policy policy, std::chrono::nanoseconds spin = {});
+
+        /**
+         * Restarts the schedule, the first deadline is one period from now
+         */
+        void start();
+
+        /**
+         * Blocks until the next deadline, starting the schedule if it hasn't been
+         * @return the number of deadlines this tick stands for, more than 1 when SKIP dropped some
+         */
+        uint32_t wait();
+
+        /**
+         * Restarts the schedule at a time the caller keeps, for running it against a virtual clock instead
+         * @param now the caller's time, on the timeline later calls to advance() use
+         */
+        void start(std::chrono::nanoseconds now);
+
+        /**
+         * Does what wait() would if it had been called at now, taking the sleep as given instead of sleeping.
+         * The tick fires at now if the deadline has passed, and at deadline() otherwise.
+         * @param now the caller's time, starting the schedule there if it hasn't been
+         * @return as for wait()
+         */
+        uint32_t advance(std::chrono::nanoseconds now);
+
+        /**
+         * @return the deadline the next tick waits for, on the timeline of start(now)
+         */
+        [[nodiscard]] std::chrono::nanoseconds deadline() const;
+
+        [[nodiscard]] const tick_stats& stats() const {
+            return m_stats;
+        }
+
+        void reset_stats() {
+            m_stats = tick_stats{};
+        }
+    };
+}
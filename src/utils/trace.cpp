@@ -0,0 +1,103 @@
+#ifdef DSU_TRACE
+#include "trace.hpp"
+
+#include <array>
+#include <cerrno>
+
+namespace utils::trace {
+    namespace {
+        struct event {
+            // Index + 1 of the span stored here, zero while it's being written, so a reader can skip torn entries
+            std::atomic<uint64_t> sequence{0};
+            const char* name = nullptr;
+            uint64_t begin = 0;
+            uint64_t end = 0;
+            int32_t arg = NO_ARG;
+            uint32_t thread = 0;
+        };
+
+        std::array<event, CAPACITY> events;
+        std::atomic<uint64_t> next_index{0};
+        std::atomic<uint32_t> next_thread{0};
+
+        uint32_t thread_id() {
+            thread_local const uint32_t id = next_thread.fetch_add(1, std::memory_order_relaxed) + 1;
+            return id;
+        }
+
+        double to_microseconds(uint64_t ticks) {
+#ifdef __WIIU__
+            return static_cast<double>(ticks) * 1000000.0 / static_cast<double>(OSTimerClockSpeed);
+#else
+            return static_cast<double>(ticks) / 1000.0;
+#endif
+        }
+    }
+
+    void record(const char* name, uint64_t begin, uint64_t end, int32_t arg) {
+        const auto index = next_index.fetch_add(1, std::memory_order_relaxed);
+        auto& slot = events[index % CAPACITY];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name = name;
+        slot.begin = begin;
+        slot.end = end;
+        slot.arg = arg;
+        slot.thread = thread_id();
+        slot.sequence.store(index + 1, std::memory_order_release);
+    }
+
+    size_t write_json(std::FILE* file) {
+        const auto last = next_index.load(std::memory_order_acquire);
+        const auto first = last > CAPACITY ? last - CAPACITY : 0;
+
+        // Timestamps are made relative to the oldest span so they stay readable
+        uint64_t origin = UINT64_MAX;
+        for (auto index = first; index < last; ++index) {
+            const auto& slot = events[index % CAPACITY];
+            if (slot.sequence.load(std::memory_order_acquire) == index + 1 && slot.begin < origin)
+                origin = slot.begin;
+        }
+
+        std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+        size_t written = 0;
+        for (auto index = first; index < last; ++index) {
+            const auto& slot = events[index % CAPACITY];
+            if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+                continue;
+            const char* name = slot.name;
+            const auto begin = slot.begin;
+            const auto end = slot.end;
+            const auto arg = slot.arg;
+            const auto thread = slot.thread;
+            // Overwritten while it was being read, the fence keeps the reads from moving past the check
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != index + 1)
+                continue;
+            // Finished after the first pass, a span that started before the origin would get a negative timestamp
+            if (begin < origin)
+                continue;
+
+            std::fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                         written == 0 ? "" : ",", name, static_cast<unsigned>(thread),
+                         to_microseconds(begin - origin), to_microseconds(end - begin));
+            if (arg != NO_ARG)
+                std::fprintf(file, ",\"args\":{\"client\":%d}", static_cast<int>(arg));
+            std::fputc('}', file);
+            ++written;
+        }
+        std::fputs("\n]}\n", file);
+        return written;
+    }
+
+    ssize_t write_json(const char* path) {
+        auto* const file = std::fopen(path, "w");
+        if (file == nullptr)
+            return -errno;
+        const auto written = write_json(file);
+        if (std::fclose(file) != 0)
+            return -errno;
+        return static_cast<ssize_t>(written);
+    }
+}
+#endif
@@ -0,0 +1,92 @@
+#pragma once
+
+#ifdef DSU_TRACE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef __WIIU__
+#include <coreinit/time.h>
+#else
+#include <time.h>
+#endif
+
+#ifndef DSU_TRACE_EVENTS
+#define DSU_TRACE_EVENTS 4096
+#endif
+
+namespace utils::trace {
+    constexpr size_t CAPACITY = DSU_TRACE_EVENTS;
+    // Spans that aren't about a particular client
+    constexpr int32_t NO_ARG = -1;
+
+    /**
+     * @return the raw tick counter, bus ticks on the console and nanoseconds on the host
+     */
+    inline uint64_t now() {
+#ifdef __WIIU__
+        return static_cast<uint64_t>(OSGetSystemTime());
+#else
+        timespec time{};
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_nsec);
+#endif
+    }
+
+    /**
+     * Records a finished span into the ring, overwriting the oldest one when full
+     * @param name a string literal, only the pointer is kept
+     * @param begin the tick the span started at
+     * @param end the tick the span ended at
+     * @param arg a client index or NO_ARG
+     */
+    void record(const char* name, uint64_t begin, uint64_t end, int32_t arg);
+
+    /**
+     * Writes the ring, oldest first, as Chrome trace-event JSON, which Perfetto and chrome://tracing open directly
+     * @param file an open file to write to
+     * @return the number of spans written
+     */
+    size_t write_json(std::FILE* file);
+
+    /**
+     * @param path the file to create or replace
+     * @return the number of spans written, or a negative error (see errno) if the file couldn't be written
+     */
+    ssize_t write_json(const char* path);
+
+    /**
+     * Records the time between its construction and destruction as one span
+     */
+    class scope {
+        const char* m_name;
+        int32_t m_arg;
+        uint64_t m_begin;
+    public:
+        explicit scope(const char* name, int32_t arg = NO_ARG)
+        : m_name(name), m_arg(arg), m_begin(now()) {}
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+        ~scope() {
+            record(m_name, m_begin, now(), m_arg);
+        }
+    };
+}
+
+#define TRACE_CONCAT_INNER(A, B) A##B
+#define TRACE_CONCAT(A, B) TRACE_CONCAT_INNER(A, B)
+// Times the rest of the enclosing block
+#define TRACE_SCOPE(NAME) const utils::trace::scope TRACE_CONCAT(trace_scope_, __LINE__){NAME}
+// Times the rest of the enclosing block, tagged with a client index
+#define TRACE_SCOPE_ARG(NAME, ARG) const utils::trace::scope TRACE_CONCAT(trace_scope_, __LINE__){NAME, static_cast<int32_t>(ARG)}
+
+#else
+
+#define TRACE_SCOPE(NAME) do {} while (0)
+#define TRACE_SCOPE_ARG(NAME, ARG) do {} while (0)
+
+#endif
@@ -41,6 +41,7 @@ namespace utils {
          */
         void write(const std::vector<uint8_t>& out_container, size_t size, size_t offset = 0){
             std::copy(out_container.begin() + offset,  out_container.begin() + offset + size, m_data + m_cursor);
+            m_cursor += size;
 
         }
         /**
@@ -51,6 +52,7 @@ namespace utils {
          */
         void write(const uint8_t* outBuffer, size_t size, size_t offset = 0){
             std::copy(outBuffer + offset, outBuffer + offset + size, m_data + m_cursor);
+            m_cursor += size;
 
         }
 
@@ -63,6 +65,7 @@ namespace utils {
         void write(const void* src, size_t size, size_t offset = 0){
             const auto dup = const_cast<void*>(src);
             std::memcpy(m_data + m_cursor, reinterpret_cast<uint8_t*>(dup) + offset, size);
+            m_cursor += size;
         }
 
         /**
@@ -71,7 +74,8 @@ namespace utils {
          * @return whether the position was successfully seeked
          */
         bool seek(size_t pos){
-            if (pos < m_end){
+            // The end itself is a valid position, a packet encoded into a buffer of its exact size finishes there
+            if (pos <= m_end){
                 m_cursor = pos;
                 return true;
             }
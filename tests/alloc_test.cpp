@@ -0,0 +1,197 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "utils/alloc_tracker.h"
+
+// The server's main, renamed with DSU_ENTRY_POINT
+int run_server();
+// Built with DSU_SERVER_PORT=0, the server publishes the port it was given here
+extern std::atomic<uint16_t> bound_port;
+
+/*
+ * Runs the whole server against clients sending every request type it handles, more clients than it has table
+ * entries so entries keep changing hands, and fails if anything allocates once the supervisor has marked the end of
+ * warm-up. The clients only use stack buffers and system calls, anything counted comes from the server.
+ */
+namespace {
+    using namespace std::chrono_literals;
+
+    constexpr auto BIND_TIMEOUT = 2s;
+    // More than the default client table holds
+    constexpr size_t CLIENTS = 24;
+    // The supervisor marks the steady state once the server has run for a second
+    constexpr auto WARM_UP = 1500ms;
+    constexpr auto MEASURED = 3s;
+
+    enum message_type : uint32_t {
+        PROTOCOL_VERSION = 0x100000,
+        CONTROLLER_INFO = 0x100001,
+        CONTROLLER_DATA = 0x100002,
+        MULTICAST_GROUP = 0x100008,
+        MOTION_BATCH = 0x100009,
+        PORT_MOTOR_INFO = 0x110001,
+        RUMBLE = 0x110002
+    };
+
+    void put_u16(uint8_t* out, uint16_t value) {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    void put_u32(uint8_t* out, uint32_t value) {
+        for (int i = 0; i < 4; ++i)
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+
+    // CRC-32 as the protocol uses it, bit by bit since the test only sends a few thousand datagrams
+    uint32_t crc32(const uint8_t* data, size_t length) {
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < length; ++i) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc >> 1) ^ ((crc & 1u) != 0 ? 0xEDB88320u : 0);
+        }
+        return ~crc;
+    }
+
+    /**
+     * Writes a client request, little endian like the wire format, CRC included
+     * @return the length of the datagram
+     */
+    size_t build_request(uint8_t* out, uint32_t client, message_type type, const uint8_t* body, size_t bodyLength) {
+        std::memcpy(out, "DSUC", 4);
+        put_u16(out + 4, 1001);
+        put_u16(out + 6, static_cast<uint16_t>(bodyLength + 4));
+        put_u32(out + 8, 0);
+        put_u32(out + 12, client);
+        put_u32(out + 16, type);
+        std::memcpy(out + 20, body, bodyLength);
+        put_u32(out + 8, crc32(out, 20 + bodyLength));
+        return 20 + bodyLength;
+    }
+
+    /**
+     * Sends the next request in the rotation for a client
+     */
+    void send_request(int socket, const sockaddr_in& server, uint32_t client, uint32_t step) {
+        // Slot based requests all start with a CONTROLLER_DATA style selection: subscribe to slot 0
+        const std::array<uint8_t, 10> slotZero{1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        const std::array<uint8_t, 8> info{4, 0, 0, 0, 0, 1, 2, 3};
+        std::array<uint8_t, 10> body = slotZero;
+        std::array<uint8_t, 64> datagram{};
+        size_t length = 0;
+        switch (step % 7) {
+            case 0:
+                length = build_request(datagram.data(), client, PROTOCOL_VERSION, nullptr, 0);
+                break;
+            case 1:
+                length = build_request(datagram.data(), client, CONTROLLER_INFO, info.data(), info.size());
+                break;
+            case 2:
+                length = build_request(datagram.data(), client, CONTROLLER_DATA, body.data(), 8);
+                break;
+            case 3:
+                length = build_request(datagram.data(), client, MULTICAST_GROUP, nullptr, 0);
+                break;
+            case 4:
+                // Every other client takes its motion in batches of 4
+                body[8] = client % 2 == 0 ? 4 : 0;
+                length = build_request(datagram.data(), client, MOTION_BATCH, body.data(), 9);
+                break;
+            case 5:
+                length = build_request(datagram.data(), client, PORT_MOTOR_INFO, body.data(), 8);
+                break;
+            default:
+                body[8] = 0;
+                body[9] = static_cast<uint8_t>(step * 37);
+                length = build_request(datagram.data(), client, RUMBLE, body.data(), 10);
+                break;
+        }
+        sendto(socket, datagram.data(), length, MSG_DONTWAIT, reinterpret_cast<const sockaddr*>(&server), sizeof(server));
+    }
+
+    /**
+     * @return the number of datagrams read
+     */
+    size_t drain(int socket) {
+        std::array<uint8_t, 512> buffer{};
+        size_t count = 0;
+        while (recv(socket, buffer.data(), buffer.size(), MSG_DONTWAIT) > 0)
+            ++count;
+        return count;
+    }
+
+    /**
+     * Keeps every client sending and reading until the deadline
+     * @return the number of datagrams the clients received
+     */
+    size_t drive(const std::array<int, CLIENTS>& sockets, const sockaddr_in& server, std::chrono::steady_clock::time_point until, uint32_t& step) {
+        size_t received = 0;
+        while (std::chrono::steady_clock::now() < until) {
+            for (size_t client = 0; client < CLIENTS; ++client) {
+                send_request(sockets[client], server, static_cast<uint32_t>(client), step);
+                received += drain(sockets[client]);
+            }
+            ++step;
+            std::this_thread::sleep_for(2ms);
+        }
+        return received;
+    }
+}
+
+int main() {
+    if (!utils::alloc_tracker::enabled) {
+        std::fputs("Built without DSU_TRACK_ALLOCATIONS\n", stderr);
+        return 1;
+    }
+
+    std::thread server(run_server);
+    const auto bindDeadline = std::chrono::steady_clock::now() + BIND_TIMEOUT;
+    while (bound_port.load(std::memory_order_acquire) == 0 && std::chrono::steady_clock::now() < bindDeadline)
+        std::this_thread::sleep_for(1ms);
+    const auto port = bound_port.load(std::memory_order_acquire);
+    if (port == 0) {
+        std::fputs("The server never bound its socket\n", stderr);
+        std::raise(SIGTERM);
+        server.join();
+        return 1;
+    }
+    const auto start = std::chrono::steady_clock::now();
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::array<int, CLIENTS> sockets{};
+    for (auto& socket : sockets)
+        socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+    uint32_t step = 0;
+    const auto warmUp = drive(sockets, address, start + WARM_UP, step);
+    const auto measured = drive(sockets, address, start + WARM_UP + MEASURED, step);
+    // Read before shutting down, tearing the server down may allocate
+    const auto allocations = utils::alloc_tracker::steady_state_allocations();
+
+    std::raise(SIGTERM);
+    server.join();
+    for (const auto socket : sockets)
+        close(socket);
+
+    std::printf("%zu datagrams received during warm-up, %zu after, %u heap allocations after warm-up\n", warmUp, measured, allocations);
+    if (measured == 0) {
+        std::fputs("The server never answered\n", stderr);
+        return 1;
+    }
+    return allocations == 0 ? 0 : 1;
+}
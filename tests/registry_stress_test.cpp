@@ -0,0 +1,88 @@
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include "net/client_registry.hpp"
+
+/*
+ * One writer and one reader hammering a client_registry, the way decode and sampling use it.
+ * Every round the writer replaces all clients with new ones, sharing a port and a slot that identify the round, and
+ * publishes once. A reader that saw a buffer being rebuilt under it would find entries from different rounds in one
+ * snapshot. Also meant to be run under ThreadSanitizer.
+ */
+namespace {
+    constexpr size_t CAPACITY = 16;
+    constexpr uint32_t ROUNDS = 20000;
+
+    using registry_type = net::client_registry<CAPACITY>;
+
+    uint16_t round_port(uint32_t round) {
+        return static_cast<uint16_t>(1024 + round % 60000);
+    }
+
+    uint8_t round_slot(uint32_t round) {
+        return static_cast<uint8_t>(round % net::MAX_SLOTS);
+    }
+
+    void write(registry_type& registry, std::atomic<bool>& done) {
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t round = 1; round <= ROUNDS; ++round) {
+            // Later rounds are seen later, so the table replaces the previous round's clients first
+            const auto now = start + std::chrono::microseconds(round);
+            DSU::Packets::Incoming::ControllerData request{};
+            request.registration_type = DSU::RegistrationType::SLOT_BASED;
+            request.reporting_slot = round_slot(round);
+            for (uint32_t client = 0; client < CAPACITY; ++client) {
+                const auto index = registry.insert(net::client{.remote_ep = sockets::endpoint{0x0A000000 | client, round_port(round)}, .last_seen = now});
+                registry.subscribe(index, request, now);
+            }
+            registry.publish();
+        }
+        done.store(true, std::memory_order_release);
+    }
+
+    /**
+     * @return the number of torn snapshots seen
+     */
+    uint32_t read(registry_type& registry, const std::atomic<bool>& done, uint32_t& outSnapshots, uint32_t& outRounds) {
+        uint32_t torn = 0;
+        uint16_t lastPort = 0;
+        while (!done.load(std::memory_order_acquire)) {
+            const auto snapshot = registry.read(0);
+            if (snapshot->count == 0)
+                continue;
+            ++outSnapshots;
+            const auto port = snapshot->entries[0].remote_ep.port();
+            const auto slots = snapshot->entries[0].slots;
+            bool consistent = snapshot->count == CAPACITY;
+            uint32_t seen = 0;
+            for (const auto& subscriber : *snapshot) {
+                consistent &= subscriber.remote_ep.port() == port && subscriber.slots == slots && subscriber.client < CAPACITY;
+                seen |= 1u << subscriber.client;
+            }
+            consistent &= seen == (1u << CAPACITY) - 1 && std::popcount(slots) == 1;
+            torn += !consistent;
+            outRounds += port != lastPort;
+            lastPort = port;
+        }
+        return torn;
+    }
+}
+
+int main() {
+    static registry_type registry;
+    std::atomic<bool> done{false};
+    uint32_t snapshots = 0;
+    uint32_t rounds = 0;
+    uint32_t torn = 0;
+
+    std::thread reader([&] { torn = read(registry, done, snapshots, rounds); });
+    write(registry, done);
+    reader.join();
+
+    std::printf("%u snapshots read across %u rounds, %u torn\n", snapshots, rounds, torn);
+    return torn == 0 ? 0 : 1;
+}